@@ -0,0 +1,329 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <getopt.h>
+
+#include "r_index.hpp"
+
+// benchmark of the count and locate queries of the extended r-index:
+// latency percentiles, throughput and time spent in LF steps (backward
+// search) and in Phi steps (locate), for each pattern length and number of threads
+
+// struct containing command line parameters
+struct bench_args {
+  std::string filename = "";
+  std::vector<std::string> patnames; // pattern files (e.g. produced by genpattern)
+  std::vector<uint_t> lengths; // pattern lengths, the patterns are cut to their prefix (empty = whole patterns)
+  std::vector<int> threads = {1}; // numbers of query threads
+  std::string jsonname = ""; // json output file
+  bool locate = true;
+  bool first = false;
+  bool mmap = false;
+  uint_t limit = 0; // maximum number of occurrences per pattern
+  uint_t sa_occ = 0; // patterns with at most this many occurrences are located with the gCA samples
+  bool verbose = false;
+};
+
+// function that prints the instructions for using the tool
+void print_help(char** argv) {
+  std::cout << "Usage: " << argv[ 0 ] << " <input filename> [options]" << std::endl;
+  std::cout << "  Options: " << std::endl
+        << "\t-p P\tpattern file path, can be repeated, def. <input filename.pat>" << std::endl
+        << "\t-L L\tcomma separated pattern lengths, the patterns are cut to their first L characters, def. whole patterns" << std::endl
+        << "\t-t T\tcomma separated numbers of query threads, def. 1" << std::endl
+        << "\t-q \tquery type ( 0 (count) | 2 (locate) ), def. 2" << std::endl
+        << "\t-n N\treport at most N occurrences per pattern in locate queries (0 = all), def. 0" << std::endl
+        << "\t-e E\tlocate with LF steps to the gCA samples instead of Phi the patterns with at most E occurrences (0 = none, -1 = all), def. 0" << std::endl
+        << "\t-f \tsampled first rotations, def. False" << std::endl
+        << "\t-m \tuse the memory mapped index (.erm), def. False" << std::endl
+        << "\t-j J\tjson output file, def. <input filename>.bench.json" << std::endl
+        << "\t-v \tset verbose mode, def. False" << std::endl;
+
+  exit(-1);
+}
+
+// parse a comma separated list of positive integers
+template<class T>
+std::vector<T> parse_list(const char* s){
+  std::vector<T> v;
+  std::string item;
+  std::stringstream ss(s);
+  while(getline(ss, item, ',')){
+    long x = atol(item.c_str());
+    if(x < 1){ std::cerr << "Error! invalid list " << s << ".\n"; exit(-1); }
+    v.push_back(x);
+  }
+  return v;
+}
+
+// function for parsing the input arguments
+void parseArgs( int argc, char** argv, bench_args& arg ) {
+  int c;
+  extern int optind;
+
+  std::string sarg;
+  while ((c = getopt( argc, argv, "p:L:t:q:n:e:j:fmvh") ) != -1) {
+    switch(c) {
+      case 'p':
+        sarg.assign( optarg );
+        arg.patnames.push_back( sarg ); break;
+        // store a pattern file path
+      case 'L':
+        arg.lengths = parse_list<uint_t>( optarg ); break;
+        // store the pattern lengths
+      case 't':
+        arg.threads = parse_list<int>( optarg ); break;
+        // store the numbers of query threads
+      case 'q':
+        arg.locate = (atoi( optarg ) > 1); break;
+        // store query type
+      case 'n':
+        arg.limit = atoi( optarg ); break;
+        // store the maximum number of occurrences per pattern
+      case 'e':
+        arg.sa_occ = atoi( optarg ); break;
+        // store the occurrences threshold of the sampled locate
+      case 'j':
+        sarg.assign( optarg );
+        arg.jsonname.assign( sarg ); break;
+        // store the json output file
+      case 'f':
+        arg.first = true; break;
+        // sampled first rotations
+      case 'm':
+        arg.mmap = true; break;
+        // memory mapped index
+      case 'v':
+        arg.verbose = true; break;
+        // verbose mode
+      case 'h':
+        print_help(argv); exit(-1);
+        // fall through
+      default:
+        std::cout << "Unknown option. Use -h for help." << std::endl;
+        exit(-1);
+    }
+  }
+  // the only input parameter is the file name
+  if (argc == optind+1) {
+    arg.filename.assign( argv[optind] );
+  }
+  else {
+    std::cout << "Invalid number of arguments" << std::endl;
+    print_help(argv);
+  }
+  if(arg.patnames.empty()) arg.patnames.push_back(arg.filename+".pat");
+  if(arg.jsonname == "") arg.jsonname = arg.filename+".bench.json";
+}
+
+// read the patterns of a fasta file produced by genpattern (header line, pattern line)
+std::vector<std::string> read_patterns(const std::string& patname){
+  std::ifstream ifs(patname);
+  if(!ifs){ std::cerr << "Error opening " << patname << ". exiting..." << std::endl; exit(1); }
+  std::vector<std::string> patterns;
+  std::string line;
+  while(getline(ifs, line)){
+    if(!getline(ifs, line)) break;
+    patterns.push_back(line);
+  }
+  return patterns;
+}
+
+// times of a single query in nanoseconds
+struct bench_res{
+  // backward search (LF steps)
+  uint64_t lf = 0;
+  // occurrences (Phi steps)
+  uint64_t phi = 0;
+  // number of occurrences
+  uint_t nocc = 0;
+};
+
+// summary of a set of query times in microseconds
+struct bench_stats{
+  double mean = 0, p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+bench_stats summarize(std::vector<uint64_t>& t){
+  bench_stats s;
+  if(t.empty()) return s;
+  std::sort(t.begin(), t.end());
+  double sum = 0;
+  for(auto x: t){ sum += x; }
+  // nearest rank percentile
+  auto perc = [&](double q){ return t[std::max<size_t>(1, ceil(q*t.size())) - 1] / 1000.0; };
+  s.mean = sum / t.size() / 1000.0;
+  s.p50 = perc(0.5); s.p90 = perc(0.9); s.p99 = perc(0.99); s.p999 = perc(0.999);
+  s.max = t.back() / 1000.0;
+  return s;
+}
+
+// string s as a JSON string literal, with quotes and backslashes escaped
+std::string json_str(const std::string& s){
+  std::string r = "\"";
+  for(char c: s){
+    if(c == '"' or c == '\\') r += '\\';
+    r += c;
+  }
+  return r + "\"";
+}
+
+// ratio a/b, 0 if b is 0 (inf and nan are not valid JSON)
+double ratio(double a, double b){
+  return b > 0 ? a / b : 0;
+}
+
+void json_stats(std::ostream& out, const char* name, const bench_stats& s){
+  out << "\"" << name << "\": {\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90
+      << ", \"p99\": " << s.p99 << ", \"p999\": " << s.p999 << ", \"max\": " << s.max << "}";
+}
+
+// answer the queries of patterns with nth threads, res[i] is the result of patterns[i],
+// return the wall clock time in nanoseconds
+template<class index_t>
+uint64_t bench_queries(index_t& idx, bench_args& arg, std::vector<std::string>& patterns, int nth, std::vector<bench_res>& res){
+
+  const size_t chunk = 64;
+  res.assign(patterns.size(), bench_res());
+  std::atomic<size_t> next_chunk{0};
+  // the occurrences are folded in a sink so that they are not optimized away
+  std::atomic<uint64_t> sink{0};
+
+  auto worker = [&](){
+    uint64_t s = 0;
+    size_t n = patterns.size();
+    while(true){
+      size_t b = (next_chunk++) * chunk;
+      if(b >= n){ break; }
+      size_t e = std::min(n, b + chunk);
+      for(size_t i=b; i<e; ++i){
+        auto t0 = std::chrono::high_resolution_clock::now();
+        if(arg.locate){
+          auto it = idx.locate_iter(patterns[i], arg.first, arg.limit);
+          auto t1 = std::chrono::high_resolution_clock::now();
+          while(it.has_next()){ s += it.next(); }
+          auto t2 = std::chrono::high_resolution_clock::now();
+          res[i].nocc = it.size();
+          res[i].lf = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+          res[i].phi = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+        else{
+          auto rn = idx.count(patterns[i]);
+          auto t1 = std::chrono::high_resolution_clock::now();
+          res[i].nocc = rn.second>=rn.first ? (rn.second-rn.first)+1 : 0;
+          res[i].lf = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        }
+      }
+    }
+    sink += s;
+  };
+
+  auto before = std::chrono::high_resolution_clock::now();
+  std::vector<std::thread> workers;
+  for(int t=1; t<nth; ++t){ workers.emplace_back(worker); }
+  worker();
+  for(auto &t: workers){ t.join(); }
+  auto after = std::chrono::high_resolution_clock::now();
+
+  if(arg.verbose) std::cout << "Sink: " << sink << std::endl;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+}
+
+// run the benchmark for each pattern file, pattern length and number of threads
+template<class index_t>
+void run_bench(index_t& idx, bench_args& arg, uint64_t load){
+
+  // locate with the gCA samples the patterns with few occurrences
+  if(arg.sa_occ > 0){
+    if(idx.sa_rate() == 0){ std::cerr << "Error! the index does not store the gCA samples, build it with -g.\n"; exit(1); }
+    idx.set_sa_locate(arg.sa_occ);
+  }
+
+  std::ofstream json(arg.jsonname);
+  if(!json){ std::cerr << "Error opening " << arg.jsonname << ". exiting..." << std::endl; exit(1); }
+  json << "{\n  \"index\": " << json_str(arg.filename) << ", \"mapped\": " << (arg.mmap ? "true" : "false")
+       << ", \"query\": \"" << (arg.locate ? "locate" : "count") << "\", \"limit\": " << arg.limit << ", \"sa_locate\": " << (arg.sa_occ == uint_t(-1) ? int64_t(-1) : int64_t(arg.sa_occ))
+       << ", \"load_ms\": " << load << ",\n  \"runs\": [";
+
+  std::cout << "file\tlength\tthreads\tpatterns\toccs\tqps\tp50(us)\tp90(us)\tp99(us)\tp999(us)\tlf(%)\tphi(ns/occ)" << std::endl;
+  bool first_run = true;
+  for(auto &patname: arg.patnames){
+    std::vector<std::string> all = read_patterns(patname);
+    // 0 = whole patterns
+    std::vector<uint_t> lengths = arg.lengths;
+    if(lengths.empty()) lengths.push_back(0);
+
+    for(auto len: lengths){
+      // cut the patterns to their prefix of length len, skip the shorter ones
+      std::vector<std::string> patterns;
+      for(auto &p: all){
+        if(len == 0){ patterns.push_back(p); }
+        else if(p.size() >= len){ patterns.push_back(p.substr(0, len)); }
+      }
+      if(patterns.empty()){
+        std::cerr << "Warning, no patterns of length " << len << " in " << patname << std::endl;
+        continue;
+      }
+
+      for(auto nth: arg.threads){
+        std::vector<bench_res> res;
+        uint64_t wall = bench_queries(idx, arg, patterns, nth, res);
+
+        std::vector<uint64_t> tot(res.size()), lf(res.size()), phi(res.size());
+        uint64_t occ_tot = 0, lf_tot = 0, phi_tot = 0, len_tot = 0;
+        for(size_t i=0; i<res.size(); ++i){
+          tot[i] = res[i].lf + res[i].phi; lf[i] = res[i].lf; phi[i] = res[i].phi;
+          occ_tot += res[i].nocc; lf_tot += res[i].lf; phi_tot += res[i].phi;
+          len_tot += patterns[i].size();
+        }
+        bench_stats s_tot = summarize(tot), s_lf = summarize(lf), s_phi = summarize(phi);
+        double qps = ratio(patterns.size(), wall / 1e9);
+        double avg_len = ratio(len_tot, patterns.size());
+        double lf_share = (lf_tot + phi_tot) > 0 ? 100.0 * lf_tot / (lf_tot + phi_tot) : 0;
+        double phi_occ = occ_tot > 0 ? (double)phi_tot / occ_tot : 0;
+
+        std::cout << patname << "\t" << avg_len << "\t" << nth << "\t" << patterns.size()
+                  << "\t" << occ_tot << "\t" << qps << "\t" << s_tot.p50 << "\t" << s_tot.p90 << "\t" << s_tot.p99
+                  << "\t" << s_tot.p999 << "\t" << lf_share << "\t" << phi_occ << std::endl;
+
+        json << (first_run ? "\n" : ",\n");
+        first_run = false;
+        json << "    {\"patterns_file\": " << json_str(patname) << ", \"length\": " << len
+             << ", \"avg_length\": " << avg_len << ", \"threads\": " << nth
+             << ", \"patterns\": " << patterns.size() << ", \"occurrences\": " << occ_tot
+             << ", \"wall_ms\": " << wall / 1e6 << ", \"throughput_qps\": " << qps
+             << ", \"occ_per_s\": " << ratio(occ_tot, wall / 1e9) << ",\n     ";
+        json_stats(json, "latency_us", s_tot); json << ",\n     ";
+        json_stats(json, "lf_us", s_lf); json << ",\n     ";
+        json_stats(json, "phi_us", s_phi);
+        json << ",\n     \"lf_total_ms\": " << lf_tot / 1e6 << ", \"phi_total_ms\": " << phi_tot / 1e6
+             << ", \"phi_ns_per_occ\": " << phi_occ << "}";
+      }
+    }
+  }
+  json << "\n  ]\n}\n";
+  json.close();
+  std::cout << "Results stored in " << arg.jsonname << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  // translate command line arguments
+  bench_args arg;
+  parseArgs(argc, argv, arg);
+
+  // load the index with the type matching its layout and block size
+  with_index(arg.filename, arg.mmap, [&](auto& idx, uint64_t load){
+    if(arg.verbose) std::cout << "Index loaded in " << load << " milliseconds" << std::endl;
+    run_bench(idx, arg, load);
+  });
+
+  return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * Construction of the extended r-index in a single process.
+ *
+ * The circular PFP, the inverted list of the parse and the dictionary are kept
+ * in memory, and the eBWT runs and the gCA samples computed by pfp_ssa are pushed
+ * directly to the builders of the rle_ebwt and pred_ebwt data structures: only
+ * the index (.eri, and .erm with -m) is written to disk.
+ */
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <getopt.h>
+
+#include "r_index.hpp"
+
+// pfp construction, included after the index since it defines the max macro
+extern "C" {
+#include "pfpebwt/utils.h"
+#include "pfpebwt/xerrors.h"
+}
+#include "pfpebwt/parse.hpp"
+#include "pfpebwt/dictionary.hpp"
+#include "pfpebwt/pfp_parse.hpp"
+#include "pfpebwt/pfp_ssa.hpp"
+#include "pfpebwt/circpfp_core.hpp"
+
+// struct containing command line parameters and other globals
+struct build_args {
+  std::string filename = "";
+  size_t w = 10; // sliding window size
+  size_t p = 100; // modulus for establishing stopping w-tuples
+  int th = 0; // number of helper threads for parsing
+  uint_t B = 2; // bitvector block size
+  uint_t kmer = 0; // length of the k-mers of the lookup table
+  uint_t sa_rate = 0; // sample rate of the gCA values
+  bool sample_first = true; // sample the first rotation of each sequence
+  bool compact = false; // compact LCP of the dictionary
+  bool mmap = false; // also store the memory mapped index
+  bool blocks = false; // interleaved run-block layout of the memory mapped index
+  bool array = false; // predecessor structure in plain arrays
+  bool verbose = false;
+};
+
+// function that prints the instructions for using the tool
+void print_help(char** argv) {
+  std::cout << "Usage: " << argv[ 0 ] << " <input filename> [options]" << std::endl;
+  std::cout << "  Options: " << std::endl
+        << "\t-w W\tsliding window size for PFP, def. 10" << std::endl
+        << "\t-p P\thash modulus for PFP, def. 100" << std::endl
+        << "\t-t T\tnumber of helper threads for parsing, the cSA of the parse, the SA of the dictionary and the eBWT, def. none" << std::endl
+        << "\t-b B\tbitvector block size, def. 2" << std::endl
+        << "\t-k K\tstore a lookup table of the DNA K-mers (0 = no table, max 12), def. 0" << std::endl
+        << "\t-g S\tstore the gCA value of one position every S of each string, used by er-index to locate with LF steps the occurrences of the patterns selected with -e and the first occurrence of the patterns of at least 2S characters (0 = no samples), def. 0" << std::endl
+        << "\t-n \tdo not sample the first rotation of each sequence, def. False" << std::endl
+        << "\t-c \tstore the LCP of the dictionary in one byte per character, def. False" << std::endl
+        << "\t-m \talso store the memory mapped index (.erm), def. False" << std::endl
+        << "\t-r \tstore with -m the interleaved run-block layout of the eBWT, def. False" << std::endl
+        << "\t-a \tstore the samples of the predecessor structure in plain arrays (faster locate, larger index), def. False" << std::endl
+        << "\t-v \tset verbose mode, def. False " << std::endl;
+
+  exit(-1);
+}
+// function for parsing the input arguments
+void parseArgs( int argc, char** argv, build_args& arg ) {
+  int c;
+  extern int optind;
+
+  puts("==== Command line:");
+  for(int i=0;i<argc;i++)
+    printf(" %s",argv[i]);
+  puts("");
+
+  while ((c = getopt( argc, argv, "w:p:t:b:k:g:ncmravh") ) != -1) {
+    switch(c) {
+      case 'w':
+        arg.w = atoi( optarg ); break;
+        // sliding window size
+      case 'p':
+        arg.p = atoi( optarg ); break;
+        // hash modulus
+      case 't':
+        arg.th = atoi( optarg ); break;
+        // number of parsing threads
+      case 'b':
+        arg.B = atoi( optarg ); break;
+        // store the bitvector block size
+      case 'k':
+        arg.kmer = atoi( optarg ); break;
+        // store the length of the k-mers of the lookup table
+      case 'g':
+        arg.sa_rate = atoi( optarg ); break;
+        // store the sample rate of the gCA values
+      case 'n':
+        arg.sample_first = false; break;
+        // do not sample the first rotations
+      case 'c':
+        arg.compact = true; break;
+        // compact LCP of the dictionary
+      case 'm':
+        arg.mmap = true; break;
+        // memory mapped index
+      case 'r':
+        arg.blocks = true; break;
+        // interleaved run-block layout
+      case 'a':
+        arg.array = true; break;
+        // predecessor structure in plain arrays
+      case 'v':
+        arg.verbose = true; break;
+        // verbose mode
+      case 'h':
+        print_help(argv); exit(-1);
+        // fall through
+      default:
+        std::cout << "Unknown option. Use -h for help." << std::endl;
+        exit(-1);
+    }
+  }
+  // the only input parameter is the file name
+  if (argc == optind+1) {
+    arg.filename.assign( argv[optind] );
+  }
+  else {
+    std::cout << "Invalid number of arguments" << std::endl;
+    print_help(argv);
+  }
+  // check parameters
+  if(arg.w < 4){ std::cerr << "Error! the window size must be at least 4.\n"; exit(-1); }
+  if(arg.p < 10){ std::cerr << "Error! the modulus must be at least 10.\n"; exit(-1); }
+  if(arg.th < 0){ std::cerr << "Error! the number of threads cannot be negative.\n"; exit(-1); }
+  if(arg.B < 1){ std::cerr << "Error! the block size must be positive.\n"; exit(-1); }
+  if(arg.kmer > 12){ std::cerr << "Error! the k-mer length must be at most 12.\n"; exit(-1); }
+}
+
+// output of pfp_ssa pushed to the builders of the index
+class index_output: public ssa_output{
+
+public:
+  index_output(rle_builder& runs_): runs(runs_) {}
+
+  void run(uint8_t head, size_t length){ runs.push(head, length); }
+
+  void first_sample(size_t sa){ ssam.push_back(sa); }
+
+  void last_sample(size_t sa){ esam.push_back(sa); }
+
+  // the positions of the string starting characters are not used by the index
+  void string_start(size_t pos){}
+
+  void sample(size_t pos, size_t sa){ gpos.push_back(pos); gval.push_back(sa); }
+
+  rle_builder& runs;
+  // first and last gCA samples of the runs
+  std::vector<uint_t> ssam, esam;
+  // eBWT positions and values of the gCA samples every sa_rate
+  std::vector<uint_t> gpos, gval;
+};
+
+// move the content of a memory file to v
+template<class T>
+void to_vector(mem_file& f, std::vector<T>& v){
+  v.resize(f.size/sizeof(T));
+  if(v.size() > 0){ memcpy(&v[0], f.buf, v.size()*sizeof(T)); }
+  f.clear();
+}
+
+// close a memory file opened for writing
+void close_mem(FILE *f){
+  if(fclose(f)!=0){ std::cerr << "Error closing memory file\n"; exit(1); }
+}
+
+// elapsed seconds since t
+double elapsed(std::chrono::high_resolution_clock::time_point t){
+  return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t).count();
+}
+
+int main(int argc, char** argv)
+{
+  // translate command line arguments
+  build_args arg;
+  parseArgs(argc, argv, arg);
+
+  auto start_main = std::chrono::high_resolution_clock::now();
+  auto start = start_main;
+  // files of the circular PFP, kept in memory
+  mem_file eparse, offset, last, spos, start_pos, fchar, edict, eocc;
+  {
+    // parameters of the parsing
+    Args parg;
+    parg.inputFileName = arg.filename;
+    parg.w = arg.w;
+    parg.p = arg.p;
+    parg.th = arg.th;
+    parg.verbose = arg.verbose;
+    parg.mem = true;
+    word_dict wordFreq;
+
+    std::cout << "==== Parsing " << arg.filename << "\n";
+    mem_file eparse_old, offset_old;
+    first_pass_files fp;
+    fp.parse = eparse_old.writer();
+    fp.offset = offset_old.writer();
+    fp.last = last.writer();
+    fp.first = spos.writer();
+    first_pass(parg, wordFreq, fp);
+    close_mem(fp.parse); close_mem(fp.offset); close_mem(fp.last); close_mem(fp.first);
+
+    FILE *fdict = edict.writer(), *focc = eocc.writer();
+    write_dictionary(parg, wordFreq, fdict, focc);
+    close_mem(fdict); close_mem(focc);
+
+    FILE *oldp = eparse_old.reader(), *oldoff = offset_old.reader();
+    FILE *newp = eparse.writer(), *newoff = offset.writer(), *strt = start_pos.writer(), *fch = fchar.writer();
+    remapParse(parg, wordFreq, oldp, oldoff, newp, newoff, strt, fch);
+    close_mem(oldp); close_mem(oldoff);
+    close_mem(newp); close_mem(newoff); close_mem(strt); close_mem(fch);
+  }
+  std::cout << "Parsing took: " << elapsed(start) << " seconds\n";
+  #if M64 == 0
+    // the SA of the dictionary is computed with 32 bit integers
+    if(edict.size >= (1ULL<<31)-1){
+      std::cerr << "Error, the dictionary contains more than 2^31-1 characters, please use ./er-build64. exiting..." << std::endl;
+      exit(1);
+    }
+  #endif
+
+  // string starting positions, the last one is the eBWT length
+  std::vector<uint8_t> spos_v;
+  to_vector(spos, spos_v);
+  std::vector<uint_t> onset(spos_v.size()/SABYTES);
+  for(size_t i=0; i<onset.size(); ++i){ onset[i] = get_myint(&spos_v[0], onset.size(), i); }
+
+  rle_builder runs(arg.B);
+  index_output out(runs);
+  {
+    start = std::chrono::high_resolution_clock::now();
+    std::cout << "==== Computing the inverted list of the eBWT of the parse\n";
+    std::vector<uint_p> P;
+    std::vector<uint64_t> sts;
+    std::vector<uint8_t> last_v, slast_v;
+    std::vector<uint32_t> offset_v;
+    to_vector(eparse, P);
+    to_vector(start_pos, sts);
+    to_vector(last, last_v);
+    to_vector(offset, offset_v);
+    // the sorted last positions are written to slast
+    mem_file slast;
+    std::unique_ptr<parse> il(new parse(P, sts, last_v, offset_v, slast.writer(), arg.th));
+    to_vector(slast, slast_v);
+    pfp_parse pars(*il, slast_v, spos_v);
+    il.reset();
+    std::cout << "Building the inverted list took: " << elapsed(start) << " seconds\n";
+
+    start = std::chrono::high_resolution_clock::now();
+    std::cout << "==== Computing the SA and LCP of the dictionary\n";
+    std::vector<uint8_t> d;
+    std::vector<uint32_t> occ, fch;
+    to_vector(edict, d);
+    to_vector(eocc, occ);
+    to_vector(fchar, fch);
+    dictionary dict(d, occ, fch, arg.w, arg.th, arg.compact);
+    std::cout << "Building the dictionary took: " << elapsed(start) << " seconds\n";
+
+    start = std::chrono::high_resolution_clock::now();
+    std::cout << "==== Computing the eBWT runs and the gCA samples\n";
+    pfp_ssa ssa(pars, dict, out, arg.w, arg.sample_first, arg.th, arg.sa_rate);
+    std::cout << "Computing the eBWT took: " << elapsed(start) << " seconds\n";
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  std::cout << "==== Computing the extended r-index\n";
+  r_index<>(arg.filename, runs, out.ssam, out.esam, onset, out.gpos, out.gval, arg.verbose, false, arg.kmer, arg.sa_rate);
+  // store the predecessor structure in plain arrays
+  if(arg.array){ store_array_index(arg.filename, arg.verbose); }
+  // store the memory mapped layout of the ebwt r-index
+  if(arg.mmap){ store_mapped_index(arg.filename, arg.blocks, arg.verbose); }
+  std::cout << "Building the index took: " << elapsed(start) << " seconds\n";
+
+  // integer width of the index, read by ext_r-index.py for the queries
+  std::ofstream mode(arg.filename + ".mode");
+  mode << (M64 ? "64" : "32");
+  mode.close();
+  std::cout << "==== Total construction time: " << elapsed(start_main) << " seconds\n";
+
+  return 0;
+}
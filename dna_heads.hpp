@@ -0,0 +1,205 @@
+/*
+ * Run heads of the RLE eBWT over a small alphabet (e.g. ACGTN), that can be
+ * stored in a mapped file.
+ *
+ * Each head is replaced by a 4-bit code, so that at most 16 distinct heads
+ * are supported. For each code we store the number of its occurrences before
+ * each superblock of DNA_HEADS_SB heads and, relative to the superblock,
+ * before each block of DNA_HEADS_BL heads (one cache line of codes). The
+ * counters of a block are stored together, and the occurrences inside a
+ * block are counted with a popcount over 16 codes at a time.
+ */
+
+#ifndef DNA_HEADS_HPP_
+#define DNA_HEADS_HPP_
+
+#include <vector>
+
+#include "sd_vector.hpp"
+#include "ef_vector.hpp"
+#include "mm_file.hpp"
+
+#define DNA_HEADS_SB 65536
+#define DNA_HEADS_BL 128
+// maximum number of distinct heads
+#define DNA_HEADS_SIGMA 16
+
+class dna_heads{
+
+public:
+	// identifier of the heads type in the memory mapped index
+	static const uint64_t mm_kind = 1;
+	// empty constructor
+	dna_heads(){}
+	// constructor from the heads vector (e.g. sdsl::wt_huff<>)
+	template<class wt_t>
+	dna_heads(wt_t& wt){
+		n = wt.size();
+		std::vector<uint8_t> heads(n);
+		for(uint64_t i=0; i<n; ++i){ heads[i] = wt[i]; }
+		build(heads);
+	}
+
+	uint_t size(){
+		return n;
+	}
+
+	/*
+	 * return the i-th head
+	 */
+	uint8_t operator[](uint_t i){
+		return sym[code_at(i)];
+	}
+
+	/*
+	 * number of c before position i
+	 */
+	uint_t rank(uint_t i, char c){
+		int x = code[uint8_t(c)];
+		if(x < 0) return 0;
+		uint64_t r = sb[(i/DNA_HEADS_SB)*sigma + x] + bl[(i/DNA_HEADS_BL)*sigma + x];
+		// count the codes of the block before i
+		uint64_t w = (i/DNA_HEADS_BL)*(DNA_HEADS_BL/16);
+		for(; w < i/16; ++w){ r += __builtin_popcountll(matches(bits[w], x)); }
+		if(i%16 > 0){ r += __builtin_popcountll(matches(bits[w], x) & (~0ULL >> (64 - 4*(i%16)))); }
+		return r;
+	}
+
+	/*
+	 * prefetch the counters and the block read by rank(i,c)
+	 */
+	void prefetch(uint_t i, char c){
+		__builtin_prefetch(bl.data() + (i/DNA_HEADS_BL)*sigma);
+		__builtin_prefetch(bits.data() + (i/DNA_HEADS_BL)*(DNA_HEADS_BL/16));
+	}
+
+	/*
+	 * position of the j-th c (j starts from 1)
+	 */
+	uint_t select(uint_t j, char c){
+		int x = code[uint8_t(c)];
+		assert(x >= 0 && j > 0);
+		// last superblock with less than j c before it
+		uint64_t lo = 0, hi = nsb;
+		while(hi - lo > 1){
+			uint64_t mid = (lo + hi) / 2;
+			if(sb[mid*sigma + x] < j){ lo = mid; } else { hi = mid; }
+		}
+		uint64_t r = sb[lo*sigma + x];
+		// last block of the superblock with less than j c before it
+		uint64_t b = lo*(DNA_HEADS_SB/DNA_HEADS_BL);
+		uint64_t e = std::min(nbl, b + DNA_HEADS_SB/DNA_HEADS_BL);
+		while(e - b > 1){
+			uint64_t mid = (b + e) / 2;
+			if(r + bl[mid*sigma + x] < j){ b = mid; } else { e = mid; }
+		}
+		r += bl[b*sigma + x];
+		// scan the block
+		uint64_t w = b*(DNA_HEADS_BL/16);
+		while(true){
+			uint64_t m = matches(bits[w], x);
+			uint64_t cnt = __builtin_popcountll(m);
+			if(r + cnt >= j) return w*16 + select_in_word(m, j-r-1)/4;
+			r += cnt; ++w;
+		}
+	}
+
+	/*
+	 * store the structure in a mapped file
+	 */
+	void write_mm(mm_writer &w) const {
+		w.value(n); w.value(sigma); w.value(nsb); w.value(nbl);
+		bits.write(w);
+		code.write(w);
+		sym.write(w);
+		sb.write(w);
+		bl.write(w);
+	}
+
+	/*
+	 * map the structure from a mapped file
+	 */
+	void map(mm_reader &r){
+		n = r.value<uint64_t>(); sigma = r.value<uint64_t>();
+		nsb = r.value<uint64_t>(); nbl = r.value<uint64_t>();
+		bits.map(r);
+		code.map(r);
+		sym.map(r);
+		sb.map(r);
+		bl.map(r);
+	}
+
+private:
+	// build codes and counters
+	void build(std::vector<uint8_t> &heads){
+		// assign a code to each character
+		std::vector<int8_t> code_v(256,-1);
+		std::vector<uint8_t> sym_v;
+		for(auto c: heads){
+			if(code_v[c] < 0){
+				if(sym_v.size() == DNA_HEADS_SIGMA){
+					std::cerr << "Error, more than " << DNA_HEADS_SIGMA << " distinct eBWT run heads. exiting..." << std::endl;
+					exit(1);
+				}
+				code_v[c] = sym_v.size();
+				sym_v.push_back(c);
+			}
+		}
+		sigma = std::max<uint64_t>(sym_v.size(), 1);
+		sym_v.resize(DNA_HEADS_SIGMA, 0);
+		nsb = n/DNA_HEADS_SB + 1;
+		nbl = n/DNA_HEADS_BL + 1;
+		std::vector<uint64_t> bits_v(n/16 + 1, 0);
+		std::vector<uint64_t> sb_v(sigma*nsb, 0);
+		std::vector<uint16_t> bl_v(sigma*nbl, 0);
+		std::vector<uint64_t> cnt(sigma, 0), sb_cnt(sigma, 0);
+		for(uint64_t i=0; i<=n; ++i){
+			if(i % DNA_HEADS_SB == 0){
+				for(uint64_t s=0; s<sigma; ++s){ sb_v[(i/DNA_HEADS_SB)*sigma + s] = cnt[s]; sb_cnt[s] = cnt[s]; }
+			}
+			if(i % DNA_HEADS_BL == 0){
+				for(uint64_t s=0; s<sigma; ++s){ bl_v[(i/DNA_HEADS_BL)*sigma + s] = cnt[s] - sb_cnt[s]; }
+			}
+			if(i < n){
+				uint64_t x = code_v[heads[i]];
+				bits_v[i/16] |= x << (4*(i%16));
+				cnt[x]++;
+			}
+		}
+		bits = mm_array<uint64_t>(std::move(bits_v));
+		code = mm_array<int8_t>(std::move(code_v));
+		sym  = mm_array<uint8_t>(std::move(sym_v));
+		sb   = mm_array<uint64_t>(std::move(sb_v));
+		bl   = mm_array<uint16_t>(std::move(bl_v));
+	}
+
+	// code of the i-th head
+	inline uint64_t code_at(uint64_t i) const {
+		return (bits[i/16] >> (4*(i%16))) & 0xf;
+	}
+
+	// lowest bit of each 4-bit code of w equal to x
+	static inline uint64_t matches(uint64_t w, uint64_t x){
+		uint64_t y = w ^ (x * 0x1111111111111111ULL);
+		y |= y >> 1;
+		y |= y >> 2;
+		return ~y & 0x1111111111111111ULL;
+	}
+
+	// number of heads, number of distinct heads
+	uint64_t n = 0, sigma = 0;
+	// number of superblocks and blocks
+	uint64_t nsb = 0, nbl = 0;
+	// 4-bit codes of the heads, 16 per word
+	mm_array<uint64_t> bits;
+	// code of each character (-1 if the character is not a head)
+	mm_array<int8_t> code;
+	// character of each code
+	mm_array<uint8_t> sym;
+	// absolute counters of the superblocks, sigma per superblock
+	mm_array<uint64_t> sb;
+	// counters of the blocks relative to their superblock, sigma per block
+	mm_array<uint16_t> bl;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Elias-Fano compressed bitvector that can be stored in a mapped file.
+ *
+ * It has the same interface of sd_vector. The select directories on the
+ * upper bits are stored together with the bitvector, so that nothing has to
+ * be rebuilt when the index is mapped in memory.
+ */
+
+#ifndef EF_VECTOR_HPP_
+#define EF_VECTOR_HPP_
+
+#include <vector>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "sd_vector.hpp"
+#include "mm_file.hpp"
+
+// one sample every EF_SAMPLE set (unset) bits in the select directories
+#define EF_SAMPLE 256
+
+/*
+ * position of the r-th (0-based) set bit of x
+ */
+inline uint64_t select_in_word(uint64_t x, uint64_t r){
+#ifdef __BMI2__
+	return __builtin_ctzll(_pdep_u64(1ULL << r, x));
+#else
+	for(; r>0; --r){ x &= x-1; }
+	return __builtin_ctzll(x);
+#endif
+}
+
+class ef_vector{
+
+public:
+	// empty constructor
+	ef_vector(){}
+	// constructor from the sorted positions of the set bits
+	ef_vector(std::vector<uint_t>& onset, uint_t bsize){
+		std::vector<uint64_t> ones(onset.begin(), onset.end());
+		onset.clear();
+		build(ones, bsize);
+	}
+	// constructor from a bitvector supporting rank and select (e.g. sd_vector)
+	template<class bv_t>
+	ef_vector(bv_t& bv){
+		uint64_t n = bv.size();
+		std::vector<uint64_t> ones;
+		if(n > 0){
+			uint64_t nones = bv.rank1(n);
+			ones.resize(nones);
+			for(uint64_t i=0; i<nones; ++i){ ones[i] = bv.select1(i); }
+		}
+		build(ones, n);
+	}
+
+	uint_t size(){
+		// return bitvector length
+		return u;
+	}
+
+	/*
+	 * number of set bits before position i
+	 */
+	uint_t rank1(uint_t i){
+		if(i >= u) return m;
+		uint64_t hi = uint64_t(i) >> l;
+		uint64_t lo = uint64_t(i) & low_mask();
+		// first position of bucket hi in the upper bits
+		uint64_t s = (hi == 0) ? 0 : select0(hi-1) + 1;
+		uint64_t k = s - hi;
+		// scan the bucket
+		while(k < m && high_bit(s) && get_low(k) < lo){ ++s; ++k; }
+		return k;
+	}
+
+	/*
+	 * position of the (i+1)-th set bit
+	 */
+	uint_t select1(uint_t i){
+		return ((high_select1(i) - i) << l) | get_low(i);
+	}
+
+	uint_t at(uint_t i){
+		return rank1(i+1) - rank1(i);
+	}
+
+	uint_t gapAt(uint_t i){
+		if(i==0){ return select1(0)+1; }
+		return select1(i)-select1(i-1);
+	}
+
+	/*
+	 * prefetch the words read by rank1(i), the position in the upper
+	 * and lower bits is estimated assuming that the set bits are evenly spread
+	 */
+	void prefetch(uint_t i){
+		if(i >= u) return;
+		uint64_t hi = uint64_t(i) >> l;
+		uint64_t k = (double)i / u * m;
+		if(hi > 0){ __builtin_prefetch(sel0.data() + (hi-1) / EF_SAMPLE); }
+		__builtin_prefetch(high.data() + (hi + k) / 64);
+		__builtin_prefetch(low.data() + (k * l) / 64);
+	}
+
+	/*
+	 * prefetch the select sample and the lower bits read by select1(i)
+	 */
+	void prefetch_select(uint_t i){
+		__builtin_prefetch(sel1.data() + i / EF_SAMPLE);
+		__builtin_prefetch(low.data() + (uint64_t(i) * l) / 64);
+	}
+
+	/*
+	 * store the structure in a mapped file
+	 */
+	void write_mm(mm_writer &w) const {
+		w.value(u); w.value(m); w.value(l);
+		low.write(w);
+		high.write(w);
+		sel1.write(w);
+		sel0.write(w);
+	}
+
+	/*
+	 * map the structure from a mapped file
+	 */
+	void map(mm_reader &r){
+		u = r.value<uint64_t>(); m = r.value<uint64_t>(); l = r.value<uint64_t>();
+		low.map(r);
+		high.map(r);
+		sel1.map(r);
+		sel0.map(r);
+	}
+
+private:
+	// build the structure from the sorted positions of the set bits
+	void build(std::vector<uint64_t> &ones, uint64_t n){
+		u = n; m = ones.size();
+		l = (m > 0 && u/m > 1) ? 63 - __builtin_clzll(u/m) : 0;
+		// upper bits: one bit per element plus one zero per bucket
+		uint64_t nz = (u >> l) + 1;
+		uint64_t hlen = m + nz;
+		std::vector<uint64_t> high_v((hlen+63)/64, 0);
+		std::vector<uint64_t> low_v((m*l+63)/64 + 1, 0);
+		std::vector<uint64_t> sel1_v, sel0_v;
+		sel1_v.reserve(m/EF_SAMPLE+1);
+		sel0_v.reserve(nz/EF_SAMPLE+1);
+		uint64_t k = 0;
+		for(uint64_t z=0; z<nz; ++z){
+			// elements of bucket z
+			while(k < m && (ones[k] >> l) == z){
+				uint64_t p = z + k;
+				high_v[p/64] |= 1ULL << (p%64);
+				if(k % EF_SAMPLE == 0){ sel1_v.push_back(p); }
+				if(l > 0){
+					uint64_t x = ones[k] & low_mask(), b = k*l;
+					low_v[b/64] |= x << (b%64);
+					if(b%64 + l > 64){ low_v[b/64+1] |= x >> (64 - b%64); }
+				}
+				++k;
+			}
+			// zero closing bucket z
+			if(z % EF_SAMPLE == 0){ sel0_v.push_back(z + k); }
+		}
+		assert(k == m);
+		low  = mm_array<uint64_t>(std::move(low_v));
+		high = mm_array<uint64_t>(std::move(high_v));
+		sel1 = mm_array<uint64_t>(std::move(sel1_v));
+		sel0 = mm_array<uint64_t>(std::move(sel0_v));
+	}
+
+	inline uint64_t low_mask() const { return l == 0 ? 0 : (~0ULL >> (64 - l)); }
+
+	inline bool high_bit(uint64_t p) const { return (high[p/64] >> (p%64)) & 1; }
+
+	// lower bits of the k-th element
+	inline uint64_t get_low(uint64_t k) const {
+		if(l == 0) return 0;
+		uint64_t b = k*l, off = b%64;
+		uint64_t x = low[b/64] >> off;
+		if(off + l > 64){ x |= low[b/64+1] << (64 - off); }
+		return x & low_mask();
+	}
+
+	// position of the i-th (0-based) set bit in the upper bits
+	inline uint64_t high_select1(uint64_t i) const {
+		uint64_t p = sel1[i / EF_SAMPLE], r = i % EF_SAMPLE;
+		uint64_t w = p/64, x = high[w] & (~0ULL << (p%64));
+		while(true){
+			uint64_t c = __builtin_popcountll(x);
+			if(r < c) return w*64 + select_in_word(x, r);
+			r -= c; x = high[++w];
+		}
+	}
+
+	// position of the z-th (0-based) unset bit in the upper bits
+	inline uint64_t select0(uint64_t z) const {
+		uint64_t p = sel0[z / EF_SAMPLE], r = z % EF_SAMPLE;
+		uint64_t w = p/64, x = ~high[w] & (~0ULL << (p%64));
+		while(true){
+			uint64_t c = __builtin_popcountll(x);
+			if(r < c) return w*64 + select_in_word(x, r);
+			r -= c; x = ~high[++w];
+		}
+	}
+
+	// bitvector length, number of set bits and width of the lower bits
+	uint64_t u = 0, m = 0, l = 0;
+	// lower bits of the positions
+	mm_array<uint64_t> low;
+	// upper bits of the positions in unary
+	mm_array<uint64_t> high;
+	// positions of one every EF_SAMPLE set (unset) bits of high
+	mm_array<uint64_t> sel1, sel0;
+};
+
+#endif
@@ -9,7 +9,10 @@ Tool to build the extended r-index of string collections.
 dirname = os.path.dirname(os.path.abspath(__file__))
 extrindex_exe     =  os.path.join(dirname, "build/er-index")
 extrindex64_exe   =  os.path.join(dirname, "build/er-index64")
+erbuild_exe       =  os.path.join(dirname, "build/er-build")
+erbuild64_exe     =  os.path.join(dirname, "build/er-build64")
 parseNT_exe       =  os.path.join(dirname, "build/circpfpNT.x")
+parse_exe         =  os.path.join(dirname, "build/circpfp.x")
 parsebwtNT_exe    =  os.path.join(dirname, "build/parsebwtNT.x")
 bebwtNT_exe       =  os.path.join(dirname, "build/bebwtNT.x")
 bebwtNTp64_exe    =  os.path.join(dirname, "build/bebwtNTp64.x")
@@ -24,14 +27,21 @@ def main():
     parser.add_argument('-p', '--mod', help='hash modulus for PFP (def. 100)', default=100, type=int)
     parser.add_argument('-b', '--B', help='bitvector block size for predecessor queries (def. 2)', default=2, type=int)
     #parser.add_argument('--first', help='sample first rotation of each sequence (def. False)', action='store_true')
+    parser.add_argument('-k', '--kmer', help='length of the DNA k-mers of the lookup table, at most 12 (def. 0, no table)', default=0, type=int)
     parser.add_argument('--nofirst', help='do not sample the first rotation of each sequence (def. True)', action='store_false')
     #parser.add_argument('-a', '--algo', help='eBWT construction algorithm (def. bigbwt)', default="bigbwt", type=str)
-    #parser.add_argument('-t', help='number of helper threads (def. None)', default=0, type=int)
+    parser.add_argument('-t', help='number of helper threads for parsing (def. None)', default=0, type=int)
     #parser.add_argument('-n', help='number of different primes (def. 1)', default=1, type=int)
     #parser.add_argument('--query', help='compute count and locate queries (def. False)', action='store_true')
     parser.add_argument('--pfile', help='pattern file path (def. <input filename.pat>)', default="", type=str)
     parser.add_argument('--count', help='compute count queries (def. False)', action='store_true')
     parser.add_argument('--locate', help='compute locate queries (def. False)', action='store_true')
+    parser.add_argument('--mmap', help='store and query the memory mapped index (def. False)', action='store_true')
+    parser.add_argument('--sa', help='store the gCA value of one position every SA of each string, used to locate the first occurrence of the patterns of at least 2SA characters (def. 0, no samples)', default=0, type=int)
+    parser.add_argument('--salocate', help='locate with LF steps to the gCA samples (--sa) instead of Phi the patterns with at most SALOCATE occurrences, -1 for all (def. 0, none)', default=0, type=int)
+    parser.add_argument('--array', help='store the samples of the predecessor structure in plain arrays, faster locate but larger index (def. False)', action='store_true')
+    parser.add_argument('--single', help='construct the index in a single process without temporary files (def. False)', action='store_true')
+    parser.add_argument('--compact', help='store the LCP of the dictionary in one byte per character (def. False)', action='store_true')
     parser.add_argument('--verbose',  help='verbose (def. False)',action='store_true')
     #parser.add_argument('-d',  help='use remainders instead of primes (def. False)',action='store_true')
     #parser.add_argument('--reads', help='process input ad a reads multiset (def. False)', action='store_true')
@@ -45,7 +55,32 @@ def main():
     with open(logfile_name,"a") as logfile:
 
         #if(args.algo == "bigbwt"):
-        if( args.construct ):
+        if( args.construct and args.single ):
+            # ---------- Construction with er-build, the intermediate files are kept in memory
+            start0 = time.time()
+            input_size = os.path.getsize(args.input)
+            # the dictionary is smaller than the input
+            exe = erbuild64_exe if input_size >= (2**31-1) else erbuild_exe
+            command = "{exe} {file} -w {wsize} -p {modulus} -b {bsize}".format(
+                    exe = os.path.join(args.extrindex_dir,exe),
+                    wsize=args.wsize, modulus=args.mod, bsize=args.B, file=args.input)
+            if args.t>1: command += " -t {0}".format(args.t)
+            if(not args.nofirst): command += " -n"
+            if(args.compact): command += " -c"
+            if(args.kmer > 0): command += " -k {0}".format(args.kmer)
+            if(args.sa > 0): command += " -g {0}".format(args.sa)
+            if(args.array): command += " -a"
+            if(args.mmap): command += " -m"
+            print("==== Computing the extended r-index of the input. Command:", command)
+            if(execute_command(command,logfile,logfile_name)!=True):
+                return
+            print("Total construction time: {0:.4f}".format(time.time()-start0))
+
+            index_size = os.path.getsize(args.input+".eri")
+            print("Original input size: " + str(input_size) + " bytes" )
+            print("Extended r-index size: " + str(index_size) + " bytes" )
+
+        elif( args.construct ):
             # ---------- Parsing of the input file
             start0 = start = time.time()
             '''
@@ -74,16 +109,14 @@ def main():
             else:
             '''
                 # Input is a long sequences multiset
-            '''
-            if args.t>0:
+            if args.t>1:
                 command = "{exe} {file} -w {wsize} -p {modulus} -t {th}".format(
                         exe = os.path.join(args.extrindex_dir,parse_exe),
                         wsize=args.wsize, modulus = args.mod, th=args.t, file=args.input)
             else:
-            '''
-            command = "{exe} {file} -w {wsize} -p {modulus}".format(
-                    exe = os.path.join(args.extrindex_dir,parseNT_exe),
-                    wsize=args.wsize, modulus = args.mod, file=args.input)
+                command = "{exe} {file} -w {wsize} -p {modulus}".format(
+                        exe = os.path.join(args.extrindex_dir,parseNT_exe),
+                        wsize=args.wsize, modulus = args.mod, file=args.input)
 
             print("==== Parsing. Command:", command)
             if(execute_command(command,logfile,logfile_name)!=True):
@@ -103,6 +136,7 @@ def main():
                 print("IL creation running in 32 bit mode")
                 command = "{exe} {file} -w {wsize}".format(
                          exe = os.path.join(args.extrindex_dir,parsebwtNT_exe), wsize=args.wsize, file=args.input)
+            if args.t>1: command += " -t {0}".format(args.t)
 
             print("Command:", command)
             if(execute_command(command,logfile,logfile_name)!=True):
@@ -136,6 +170,11 @@ def main():
             command += " -s"
             # sample the first rotation of each sequence
             if(args.nofirst): command += " -f"
+            if args.t>1: command += " -t {0}".format(args.t)
+            # compact LCP of the dictionary
+            if(args.compact): command += " -c"
+            # sampled gCA values, read by er-index -g
+            if(args.sa > 0): command += " -g {0}".format(args.sa)
             print("==== Computing the eBWT and the GCA-samples of the input. Command:", command)
             if(execute_command(command,logfile,logfile_name)!=True):
                 return
@@ -166,6 +205,14 @@ def main():
             f.close()
             # sample the first rotation of each sequence
             if(args.first): command += " -f"
+            # store the k-mer lookup table
+            if(args.kmer > 0): command += " -k {0}".format(args.kmer)
+            # store the sampled gCA values
+            if(args.sa > 0): command += " -g {0}".format(args.sa)
+            # store the predecessor structure in plain arrays
+            if(args.array): command += " -a"
+            # store the memory mapped index
+            if(args.mmap): command += " -m"
             # execute command
             print("==== Computing the extended r-index of the input. Command:", command)
             if(execute_command(command,logfile,logfile_name)!=True):
@@ -191,6 +238,7 @@ def main():
                 exe = os.path.join(args.extrindex_dir,extrindex_exe),
                 file=args.input, pfile=args.pfile)
             if(args.first): command += " -f"
+            if(args.mmap): command += " -m"
             print("==== Computing count queries. Command:", command)
             subprocess.check_call( command.split() )
 
@@ -207,6 +255,8 @@ def main():
                 exe = os.path.join(args.extrindex_dir,extrindex_exe),
                 file=args.input, pfile=args.pfile)
             if(args.first): command += " -f"
+            if(args.mmap): command += " -m"
+            if(args.salocate != 0): command += " -e {0}".format(args.salocate)
             print("==== Computing locate queries. Command:", command)
             subprocess.check_call( command.split() )
 
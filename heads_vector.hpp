@@ -0,0 +1,168 @@
+/*
+ * Run heads of the RLE eBWT with rank and select support, that can be
+ * stored in a mapped file.
+ *
+ * It replaces the sdsl::wt_huff<> of the heads in the memory mapped index.
+ * The heads are stored one per byte, and for each character of the heads
+ * we store the number of its occurrences before each superblock of
+ * HEADS_SB heads and, relative to the superblock, before each block of
+ * HEADS_BL heads. A rank query reads two counters and scans at most
+ * HEADS_BL-1 bytes.
+ */
+
+#ifndef HEADS_VECTOR_HPP_
+#define HEADS_VECTOR_HPP_
+
+#include <vector>
+
+#include "sd_vector.hpp"
+#include "mm_file.hpp"
+
+#define HEADS_SB 256
+#define HEADS_BL 64
+
+class heads_vector{
+
+public:
+	// identifier of the heads type in the memory mapped index
+	static const uint64_t mm_kind = 0;
+	// empty constructor
+	heads_vector(){}
+	// constructor from the heads vector (e.g. sdsl::wt_huff<>)
+	template<class wt_t>
+	heads_vector(wt_t& wt){
+		n = wt.size();
+		std::vector<uint8_t> heads(n);
+		for(uint64_t i=0; i<n; ++i){ heads[i] = wt[i]; }
+		build(heads);
+	}
+
+	uint_t size(){
+		return n;
+	}
+
+	/*
+	 * return the i-th head
+	 */
+	uint8_t operator[](uint_t i){
+		return h[i];
+	}
+
+	/*
+	 * number of c before position i
+	 */
+	uint_t rank(uint_t i, char c){
+		int32_t s = slot[uint8_t(c)];
+		if(s < 0) return 0;
+		uint64_t r = sb[s*nsb + i/HEADS_SB] + bl[s*nbl + i/HEADS_BL];
+		// scan the block
+		const uint8_t *p = h.data();
+		for(uint64_t k=(i/HEADS_BL)*HEADS_BL; k<i; ++k){ r += (p[k] == uint8_t(c)); }
+		return r;
+	}
+
+	/*
+	 * prefetch the counters and the block read by rank(i,c)
+	 */
+	void prefetch(uint_t i, char c){
+		int32_t s = slot[uint8_t(c)];
+		if(s < 0) return;
+		__builtin_prefetch(sb.data() + s*nsb + i/HEADS_SB);
+		__builtin_prefetch(bl.data() + s*nbl + i/HEADS_BL);
+		__builtin_prefetch(h.data() + (i/HEADS_BL)*HEADS_BL);
+	}
+
+	/*
+	 * position of the j-th c (j starts from 1)
+	 */
+	uint_t select(uint_t j, char c){
+		int32_t s = slot[uint8_t(c)];
+		assert(s >= 0 && j > 0);
+		// last superblock with less than j c before it
+		const uint64_t *S = sb.data() + s*nsb;
+		uint64_t lo = 0, hi = nsb;
+		while(hi - lo > 1){
+			uint64_t mid = (lo + hi) / 2;
+			if(S[mid] < j){ lo = mid; } else { hi = mid; }
+		}
+		// last block of the superblock with less than j c before it
+		const uint8_t *L = bl.data() + s*nbl;
+		uint64_t b = lo*(HEADS_SB/HEADS_BL);
+		uint64_t e = std::min(nbl, b + HEADS_SB/HEADS_BL);
+		while(b+1 < e && S[lo] + L[b+1] < j){ ++b; }
+		// scan the block
+		uint64_t r = S[lo] + L[b];
+		uint64_t k = b*HEADS_BL;
+		const uint8_t *p = h.data();
+		while(true){
+			r += (p[k] == uint8_t(c));
+			if(r == j) return k;
+			++k;
+		}
+	}
+
+	/*
+	 * store the structure in a mapped file
+	 */
+	void write_mm(mm_writer &w) const {
+		w.value(n); w.value(sigma); w.value(nsb); w.value(nbl);
+		h.write(w);
+		slot.write(w);
+		sb.write(w);
+		bl.write(w);
+	}
+
+	/*
+	 * map the structure from a mapped file
+	 */
+	void map(mm_reader &r){
+		n = r.value<uint64_t>(); sigma = r.value<uint64_t>();
+		nsb = r.value<uint64_t>(); nbl = r.value<uint64_t>();
+		h.map(r);
+		slot.map(r);
+		sb.map(r);
+		bl.map(r);
+	}
+
+private:
+	// build counters
+	void build(std::vector<uint8_t> &heads){
+		// assign a slot to each character
+		std::vector<int32_t> slot_v(256,-1);
+		sigma = 0;
+		for(auto c: heads){ if(slot_v[c] < 0){ slot_v[c] = sigma++; } }
+		nsb = n/HEADS_SB + 1;
+		nbl = n/HEADS_BL + 1;
+		std::vector<uint64_t> sb_v(sigma*nsb, 0);
+		std::vector<uint8_t> bl_v(sigma*nbl, 0);
+		std::vector<uint64_t> cnt(sigma, 0), sb_cnt(sigma, 0);
+		for(uint64_t i=0; i<=n; ++i){
+			if(i % HEADS_SB == 0){
+				for(uint64_t s=0; s<sigma; ++s){ sb_v[s*nsb + i/HEADS_SB] = cnt[s]; sb_cnt[s] = cnt[s]; }
+			}
+			if(i % HEADS_BL == 0){
+				for(uint64_t s=0; s<sigma; ++s){ bl_v[s*nbl + i/HEADS_BL] = cnt[s] - sb_cnt[s]; }
+			}
+			if(i < n){ cnt[slot_v[heads[i]]]++; }
+		}
+		h    = mm_array<uint8_t>(std::move(heads));
+		slot = mm_array<int32_t>(std::move(slot_v));
+		sb   = mm_array<uint64_t>(std::move(sb_v));
+		bl   = mm_array<uint8_t>(std::move(bl_v));
+	}
+
+	// number of heads, number of distinct characters
+	uint64_t n = 0, sigma = 0;
+	// number of superblocks and blocks
+	uint64_t nsb = 0, nbl = 0;
+	// heads
+	mm_array<uint8_t> h;
+	// slot of each character in the counters (-1 if the character is not a head)
+	mm_array<int32_t> slot;
+	// absolute counters of the superblocks
+	mm_array<uint64_t> sb;
+	// counters of the blocks relative to their superblock
+	mm_array<uint8_t> bl;
+};
+
+#endif
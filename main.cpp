@@ -7,6 +7,8 @@
 #include "r_index.hpp"
 // fasta reader function
 #include "IOfunc.hpp"
+// multithreaded queries
+#include "query_pool.hpp"
 
 // struct containing command line parameters and other globals
 struct args {
@@ -22,6 +24,15 @@ struct args {
   bool check = false; // debug only
   bool first = false;
   bool pocc = false;
+  int threads = 1; // number of query threads
+  bool mmap = false; // memory mapped index
+  bool blocks = false; // interleaved run-block layout of the memory mapped index
+  bool array = false; // predecessor structure in plain arrays
+  uint_t kmer = 0; // length of the k-mers of the lookup table
+  uint_t sa_rate = 0; // sample rate of the gCA values
+  uint_t sa_occ = 0; // patterns with at most this many occurrences are located with the gCA samples
+  uint_t limit = 0; // maximum number of occurrences per pattern
+  bool seq = false; // locate output as (string id, offset) pairs
 };
 
 // function that prints the instructions for using the tool
@@ -35,6 +46,15 @@ void print_help(char** argv) {
         << "\t-v \tset verbose mode, def. False " << std::endl
         << "\t-p P\tpattern file path, def. <input filename.pat> " << std::endl
         << "\t-o O\tbasename for the output files, def. <input filename>" << std::endl
+        << "\t-t T\tnumber of query threads, def. 1" << std::endl
+        << "\t-l \tstore the occurrences as sorted (sequence id, offset) pairs in <basename>.socc with -q 3, def. False" << std::endl
+        << "\t-n N\treport at most N occurrences per pattern in locate queries (0 = all), def. 0" << std::endl
+        << "\t-k K\tstore with -c a lookup table of the DNA K-mers (0 = no table, max 12), def. 0" << std::endl
+        << "\t-g S\tstore with -c the gCA value of one position every S of each string (read from the .gsam file of bebwt -g, or computed with LF steps), used to locate with LF steps the occurrences of the patterns selected with -e and the first occurrence of the patterns of at least 2S characters (0 = no samples), def. 0" << std::endl
+        << "\t-e E\tlocate with LF steps to the gCA samples (-g) instead of Phi the patterns with at most E occurrences (0 = none, -1 = all), def. 0" << std::endl
+        << "\t-m \tuse the memory mapped index (.erm), with -c also store it, def. False" << std::endl
+        << "\t-r \tstore with -c -m the interleaved run-block layout of the eBWT, def. False" << std::endl
+        << "\t-a \tstore with -c the samples of the predecessor structure in plain arrays (faster locate, larger index), def. False" << std::endl
         << "\t-d \tcheck locate output (debug only)" << std::endl;
 
   exit(-1);
@@ -50,7 +70,7 @@ void parseArgs( int argc, char** argv, args& arg ) {
   puts("");
  
   std::string sarg;
-  while ((c = getopt( argc, argv, "b:o:q:p:vcsihdf") ) != -1) {
+  while ((c = getopt( argc, argv, "b:o:q:p:t:k:g:e:n:vcsihdfmlra") ) != -1) {
     switch(c) {
       case 'c':
         arg.build = true; break;
@@ -80,6 +100,33 @@ void parseArgs( int argc, char** argv, args& arg ) {
         sarg.assign( optarg );
         arg.outname.assign( sarg ); break;
         // store the output files path
+      case 't':
+        arg.threads = atoi( optarg ); break;
+        // store the number of query threads
+      case 'l':
+        arg.seq = true; break;
+        // locate output as (string id, offset) pairs
+      case 'n':
+        arg.limit = atoi( optarg ); break;
+        // store the maximum number of occurrences per pattern
+      case 'k':
+        arg.kmer = atoi( optarg ); break;
+        // store the length of the k-mers of the lookup table
+      case 'g':
+        arg.sa_rate = atoi( optarg ); break;
+        // store the sample rate of the gCA values
+      case 'e':
+        arg.sa_occ = atoi( optarg ); break;
+        // store the occurrences threshold of the sampled locate
+      case 'm':
+        arg.mmap = true; break;
+        // memory mapped index
+      case 'r':
+        arg.blocks = true; break;
+        // interleaved run-block layout
+      case 'a':
+        arg.array = true; break;
+        // predecessor structure in plain arrays
       case 'd':
         arg.check = true; break;
         // check locate output
@@ -108,216 +155,355 @@ void parseArgs( int argc, char** argv, args& arg ) {
   if(arg.patname == "") arg.patname = arg.filename+".pat";
   // check mode
   if(!arg.build && (arg.query < 0 || arg.query > 3 ) ){ std::cerr << "Error! select a correct mode (either -c | -q 0 | -q 1 | -q 2 | -q 3).\n";  }
+  // check number of threads
+  if(arg.threads < 1){ std::cerr << "Error! the number of threads must be positive.\n"; exit(-1); }
+  // check k-mer length
+  if(arg.kmer > 12){ std::cerr << "Error! the k-mer length must be at most 12.\n"; exit(-1); }
 }
 
-int main(int argc, char** argv)
-{
-  // translate command line arguments
-  args arg;
-  parseArgs(argc, argv, arg);
-  // compute and store the r-Index of the eBWT
-  if(arg.build){
-    if( arg.verbose ){
-      std::cout << "Computing the eBWT r-index of: " << arg.filename 
-      << " Main bitvector blocksize selected: " << arg.B << "\n";
-      /*if( arg.pfpebwt ){ std::cout << "Reading pfpebwt files\n"; }
-      if( arg.pfpebwt || arg.read_from_stream )
-      {
-        std::cout << "Reading input files from stream\n";
-      }*/
-    }
-    // compute and store the ebwt r-index
-    r_index(arg.filename,arg.B,arg.read_from_stream,1,arg.verbose,arg.first);
+// buffered writer of the .occ file, each position is stored using 5 bytes
+class occ_writer{
+
+public:
+  occ_writer(FILE * occ_): occ(occ_) { buffer.reserve(5*4096); }
+
+  ~occ_writer(){ flush(); }
+
+  // append a position
+  void push(uint_t pos){
+    uint64_t p = pos;
+    for(int j=0; j<5; ++j){ buffer.push_back((p >> (8*j)) & 0xff); }
+    if(buffer.size() >= 5*4096){ flush(); }
   }
-  else if(!arg.check){
 
-    // load r-index data structures
-    std::string input_file  = arg.filename + ".eri";
-    // open stream
-    std::ifstream in(input_file);
+  // append the positions of a pattern
+  void write(std::vector<uint_t>& OCC){
+    for(auto pos: OCC){ push(pos); }
+  }
 
-    // start test
-    auto t1 = std::chrono::high_resolution_clock::now();
+  // append the (string id, offset) pairs of a pattern
+  void write(std::vector<seq_pos_t>& SOCC){
+    for(auto &p: SOCC){ push(p.first); push(p.second); }
+  }
 
-    r_index idx = r_index();
-    // load
-    idx.load(in);
+  void flush(){
+    if(buffer.size() == 0) return;
+    if(fwrite(&buffer[0],1,buffer.size(),occ) != buffer.size()){ std::cerr << "Error writing .occ file\n"; exit(1); }
+    buffer.clear();
+  }
 
-    auto t2 = std::chrono::high_resolution_clock::now();
+private:
+  FILE * occ;
+  std::vector<uint8_t> buffer;
+};
 
-    in.close();
+// compute the count/locate queries using arg.threads threads sharing the same index,
+// the patterns are read in windows and the results are written in input order
+template<class index_t>
+void mt_queries(index_t& idx, args& arg, std::ifstream& ifs, int64_t noSeq, int64_t& occ_tot, size_t& query_time){
+
+  bool locate = (arg.query > 1);
+  // number of patterns per chunk and per window
+  const size_t chunk = 64;
+  const size_t window = size_t(arg.threads) * chunk * 16;
+
+  std::cout << "Computing " << (locate ? "locate" : "count") << " queries using " << arg.threads << " threads..." << std::endl;
+  // open output files
+  FILE * nocc = NULL, * ptime = NULL, * occ = NULL;
+  if(arg.query == 1){
+    std::string output_file   = arg.patname + ".noccEBWT";
+    std::string output_file2  = arg.patname + ".timeEBWT";
+    nocc  = fopen(output_file.c_str(), "w+");
+    ptime = fopen(output_file2.c_str(),"w+");
+  }
+  if(arg.query == 3){
+    std::string output_file  = arg.filename + (arg.seq ? ".socc" : ".occ");
+    occ = fopen(output_file.c_str(),"w+");
+  }
+  occ_writer occ_w(occ);
+
+  // only the throughput is reported with -q 2, so the chunks are located in batches
+  query_pool<index_t> pool(idx, arg.threads, chunk, locate, arg.first, arg.limit, arg.seq && occ != NULL, arg.query == 2);
+  std::vector<std::string> patterns;
+  std::vector<query_res> res;
+  std::string pattern;
+  int64_t done = 0, last_perc = 0;
+
+  while(done < noSeq){
+    // read the next window of patterns
+    patterns.clear();
+    for(int64_t i=done; i<noSeq && patterns.size()<window; ++i){
+      getline(ifs, pattern);
+      getline(ifs, pattern);
+      patterns.push_back(pattern);
+    }
+    // answer the queries in parallel
+    auto before = std::chrono::high_resolution_clock::now();
+    pool.run(patterns, res);
+    auto after = std::chrono::high_resolution_clock::now();
+    query_time += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+    // write the results in input order
+    for(size_t i=0; i<res.size(); ++i){
+      if(nocc != NULL){
+        fwrite(&res[i].nocc,4,1,nocc);
+        fwrite(&res[i].time,sizeof(float),1,ptime);
+      }
+      if(occ != NULL && arg.seq){ occ_w.write(res[i].socc); }
+      else if(occ != NULL){ occ_w.write(res[i].occ); }
+      occ_tot += res[i].nocc;
+    }
+    done += patterns.size();
 
-    std::cout << "Searching patterns in file: " << arg.patname << std::endl;
-    std::ifstream ifs(arg.patname);
+    int64_t perc = (100*done)/noSeq;
+    if( perc > last_perc && done < noSeq ){
+      std::cout << perc << "% done ..." << std::endl;
+      last_perc = perc;
+    }
+  }
+  // close output files
+  if(nocc != NULL){ fclose(nocc); fclose(ptime); }
+  if(occ != NULL){ occ_w.flush(); fclose(occ); }
+}
 
-    int64_t noSeq = 0; std::string line;
-    while (getline(ifs, line)){ noSeq++; }
-    noSeq /= 2;
-    ifs.clear();
-    ifs.seekg(0, std::ios::beg);
+// compute the count/locate queries of the patterns in arg.patname using the index idx,
+// load is the index loading time in milliseconds
+template<class index_t>
+void run_queries(index_t& idx, args& arg, uint64_t load){
 
-    int64_t perc = 0, last_perc = 0;
-    int64_t occ_tot=0;
-    std::string pattern = std::string();
+  // locate with the gCA samples the patterns with few occurrences
+  if(arg.sa_occ > 0){
+    if(idx.sa_rate() == 0){ std::cerr << "Error! the index does not store the gCA samples, build it with -g.\n"; exit(1); }
+    idx.set_sa_locate(arg.sa_occ);
+  }
 
-    // initialize stats vector
-    std::vector<double> STAT(5,0);
+  std::cout << "Searching patterns in file: " << arg.patname << std::endl;
+  std::ifstream ifs(arg.patname);
 
-    size_t query_time = 0;
+  int64_t noSeq = 0; std::string line;
+  while (getline(ifs, line)){ noSeq++; }
+  noSeq /= 2;
+  ifs.clear();
+  ifs.seekg(0, std::ios::beg);
 
-    auto t3 = std::chrono::high_resolution_clock::now();
+  int64_t perc = 0, last_perc = 0;
+  int64_t occ_tot=0;
+  std::string pattern = std::string();
 
-    if(arg.query < 2){
-      FILE * nocc, * ptime;
-      arg.pocc = (arg.query == 1);
-      std::cout << "Computing count queries..." << std::endl;
-      if(arg.query == 1)
-      {
-        std::string output_file   = arg.patname + ".noccEBWT";
-        std::string output_file2  = arg.patname + ".timeEBWT";
-        // open output file
-        nocc  = fopen(output_file.c_str(), "w+");
-        ptime = fopen(output_file2.c_str(),"w+");
-      
-  	    //extract patterns from file and search them in the index
-        //if(arg.pocc){
-    		for(int64_t i=0; i<noSeq; ++i){
-
-    			perc = (100*i)/noSeq;
-    			if( perc > last_perc ){
-    				std::cout << perc << "% done ..." << std::endl;
-    				last_perc = perc;
-    		  }
-
-    			getline(ifs, pattern);
-    			getline(ifs, pattern);
-
-          auto before = std::chrono::high_resolution_clock::now();
-    			auto rn = idx.count(pattern);
-          uint_t curr_occ = rn.second>=rn.first ? (rn.second-rn.first)+1 : 0;
-          auto after = std::chrono::high_resolution_clock::now();
-
-          fwrite(&curr_occ,4,1,nocc);
-          std::chrono::duration<double, std::milli> patt_time = after - before;
-          float dur_patt = patt_time.count();
-          fwrite(&dur_patt,sizeof(float),1,ptime);
-          occ_tot += curr_occ;
-    		}
-        // close output files
-        fclose(nocc); fclose(ptime);
-      }
-      else
-      {
-        for(int64_t i=0; i<noSeq; ++i){
+  // initialize stats vector
+  std::vector<double> STAT(5,0);
 
-          perc = (100*i)/noSeq;
-          if( perc > last_perc ){
-            std::cout << perc << "% done ..." << std::endl;
-            last_perc = perc;
-          }
+  size_t query_time = 0;
 
-          getline(ifs, pattern);
-          getline(ifs, pattern);
+  auto t3 = std::chrono::high_resolution_clock::now();
 
-          auto before = std::chrono::high_resolution_clock::now();
-          auto rn = idx.count(pattern);
-          auto after = std::chrono::high_resolution_clock::now();
-          occ_tot += rn.second>=rn.first ? (rn.second-rn.first)+1 : 0;
-          query_time += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
-        }
-      }
+  if(arg.threads > 1){
+    mt_queries(idx, arg, ifs, noSeq, occ_tot, query_time);
 
-  		double occ_avg = (double)occ_tot / noSeq;
+    double occ_avg = (double)occ_tot / noSeq;
 
-      STAT[0] = occ_tot; STAT[1] = occ_avg;
+    STAT[0] = occ_tot; STAT[1] = occ_avg;
 
-  		std::cout << std::endl << occ_avg << " average occurrences per pattern" << std::endl;
+    std::cout << std::endl << occ_avg << " average occurrences per pattern" << std::endl;
+  }
+  else if(arg.query < 2){
+    FILE * nocc, * ptime;
+    arg.pocc = (arg.query == 1);
+    std::cout << "Computing count queries..." << std::endl;
+    if(arg.query == 1)
+    {
+      std::string output_file   = arg.patname + ".noccEBWT";
+      std::string output_file2  = arg.patname + ".timeEBWT";
+      // open output file
+      nocc  = fopen(output_file.c_str(), "w+");
+      ptime = fopen(output_file2.c_str(),"w+");
+    
+	    //extract patterns from file and search them in the index
+      //if(arg.pocc){
+  		for(int64_t i=0; i<noSeq; ++i){
+
+  			perc = (100*i)/noSeq;
+  			if( perc > last_perc ){
+  				std::cout << perc << "% done ..." << std::endl;
+  				last_perc = perc;
+  		  }
+
+  			getline(ifs, pattern);
+  			getline(ifs, pattern);
+
+        auto before = std::chrono::high_resolution_clock::now();
+  			auto rn = idx.count(pattern);
+        uint_t curr_occ = rn.second>=rn.first ? (rn.second-rn.first)+1 : 0;
+        auto after = std::chrono::high_resolution_clock::now();
+
+        fwrite(&curr_occ,4,1,nocc);
+        std::chrono::duration<double, std::milli> patt_time = after - before;
+        float dur_patt = patt_time.count();
+        fwrite(&dur_patt,sizeof(float),1,ptime);
+        occ_tot += curr_occ;
+  		}
+      // close output files
+      fclose(nocc); fclose(ptime);
     }
-    else if(arg.query > 1)
+    else
     {
-      std::cout << "Computing locate queries..." << std::endl;
-      // initialize output file
-      FILE * occ;
-      if(arg.query==3)
-      {
-        std::string output_file  = arg.filename + ".occ";
-        // open output file
-        occ = fopen(output_file.c_str(),"w+");
+      // no per-pattern output, the patterns are counted in batches
+      const int64_t window = 1024;
+      std::vector<std::string> patterns;
+      for(int64_t i=0; i<noSeq; i+=window){
+
+        perc = (100*i)/noSeq;
+        if( perc > last_perc ){
+          std::cout << perc << "% done ..." << std::endl;
+          last_perc = perc;
+        }
 
-    		//extract patterns from file and search them in the index
-    		for(int64_t i=0; i<noSeq; ++i){
+        patterns.clear();
+        for(int64_t j=i; j<std::min(noSeq, i+window); ++j){
+          getline(ifs, pattern);
+          getline(ifs, pattern);
+          patterns.push_back(pattern);
+        }
 
-      		perc = (100*i)/noSeq;
-      		if( perc > last_perc ){
-      			std::cout << perc << "% done ..." << std::endl;
-      			last_perc = perc;
-      		}
+        auto before = std::chrono::high_resolution_clock::now();
+        auto rns = idx.count_batch(patterns);
+        auto after = std::chrono::high_resolution_clock::now();
+        for(auto &rn: rns){ occ_tot += rn.second>=rn.first ? (rn.second-rn.first)+1 : 0; }
+        query_time += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+      }
+    }
 
-      		getline(ifs, pattern);
-      		getline(ifs, pattern);
+		double occ_avg = (double)occ_tot / noSeq;
 
-      		auto OCC = idx.locate_all(pattern,arg.first);
+    STAT[0] = occ_tot; STAT[1] = occ_avg;
 
-          if(OCC.size() > 0) fwrite(&OCC[0],5,OCC.size(),occ);
-      		
-      		occ_tot += OCC.size();
+		std::cout << std::endl << occ_avg << " average occurrences per pattern" << std::endl;
+  }
+  else if(arg.query > 1)
+  {
+    std::cout << "Computing locate queries..." << std::endl;
+    // initialize output file
+    FILE * occ;
+    if(arg.query==3)
+    {
+      std::string output_file  = arg.filename + (arg.seq ? ".socc" : ".occ");
+      // open output file
+      occ = fopen(output_file.c_str(),"w+");
+      occ_writer occ_w(occ);
+
+  		//extract patterns from file and search them in the index
+  		for(int64_t i=0; i<noSeq; ++i){
+
+    		perc = (100*i)/noSeq;
+    		if( perc > last_perc ){
+    			std::cout << perc << "% done ..." << std::endl;
+    			last_perc = perc;
     		}
-        // close output file
-        if(arg.query==3) fclose(occ);
-      }
-      else
-      {
-        //extract patterns from file and search them in the index
-        for(int64_t i=0; i<noSeq; ++i){
 
-          perc = (100*i)/noSeq;
-          if( perc > last_perc ){
-            std::cout << perc << "% done ..." << std::endl;
-            last_perc = perc;
-          }
+    		getline(ifs, pattern);
+    		getline(ifs, pattern);
 
+        if(arg.seq){
+          // the occurrences are sorted and converted to (string id, offset) pairs
+          auto SOCC = idx.locate_seq(pattern, arg.first, arg.limit);
+          occ_w.write(SOCC);
+          occ_tot += SOCC.size();
+        }
+        else{
+          // the occurrences are streamed to the output file
+          occ_tot += idx.locate(pattern, [&](uint_t pos){ occ_w.push(pos); }, arg.first, arg.limit);
+        }
+  		}
+      // close output file
+      occ_w.flush();
+      fclose(occ);
+    }
+    else
+    {
+      // the occurrences are not stored, only folded in sink, and
+      // the patterns are located in batches
+      uint_t sink = 0;
+      const int64_t window = 1024;
+      std::vector<std::string> patterns;
+      for(int64_t i=0; i<noSeq; i+=window){
+
+        perc = (100*i)/noSeq;
+        if( perc > last_perc ){
+          std::cout << perc << "% done ..." << std::endl;
+          last_perc = perc;
+        }
+
+        patterns.clear();
+        for(int64_t j=i; j<std::min(noSeq, i+window); ++j){
           getline(ifs, pattern);
           getline(ifs, pattern);
-
-          auto before = std::chrono::high_resolution_clock::now();
-          auto OCC = idx.locate_all(pattern,arg.first);
-          auto after = std::chrono::high_resolution_clock::now();
-          query_time += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
-          
-          occ_tot += OCC.size();
-
+          patterns.push_back(pattern);
         }
+
+        auto before = std::chrono::high_resolution_clock::now();
+        idx.locate_batch(patterns, [&](size_t j, uint_t pos){ sink ^= pos; occ_tot++; }, arg.first, arg.limit);
+        auto after = std::chrono::high_resolution_clock::now();
+        query_time += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
       }
+      if(arg.verbose){ std::cout << "Checksum of the occurrences: " << sink << std::endl; }
+    }
 
-  		double occ_avg = (double)occ_tot / noSeq;
+		double occ_avg = (double)occ_tot / noSeq;
 
-      STAT[0] = occ_tot; STAT[1] = occ_avg;
+    STAT[0] = occ_tot; STAT[1] = occ_avg;
 
-  		std::cout << std::endl << occ_avg << " average occurrences per pattern" << std::endl;
+		std::cout << std::endl << occ_avg << " average occurrences per pattern" << std::endl;
 
-  	}
+	}
 
-    ifs.close();
+  ifs.close();
 
-    auto t4 = std::chrono::high_resolution_clock::now();
+  auto t4 = std::chrono::high_resolution_clock::now();
 
-    uint64_t load = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-    std::cout << "Load time : " << load << " milliseconds" << std::endl;
+  std::cout << "Load time : " << load << " milliseconds" << std::endl;
 
-    uint64_t search = std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count();
-    std::cout << "number of patterns n = " << noSeq << std::endl;
-    std::cout << "total number of occurrences  occ_t = " << occ_tot << std::endl;
+  uint64_t search = std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count();
+  std::cout << "number of patterns n = " << noSeq << std::endl;
+  std::cout << "total number of occurrences  occ_t = " << occ_tot << std::endl;
 
-    std::cout << "Total time : " << (double)query_time/1000000 << " milliseconds" << std::endl;
-    std::cout << "Search time : " << ((double)query_time/1000000)/noSeq << " milliseconds/pattern (total: " << noSeq << " patterns)" << std::endl;
-    std::cout << "Search time : " << ((double)query_time/1000000)/occ_tot << " milliseconds/occurrence (total: " << occ_tot << " occurrences)" << std::endl;
-    
-    // store some statistics
-    STAT[2] = (double)query_time/1000000; STAT[3] = ((double)query_time/1000000)/noSeq; STAT[4] = ((double)query_time/1000000)/occ_tot;
-    std::string stat_file  = arg.filename + ".stats";
-    FILE * stat = fopen(stat_file.c_str(),"w");
-    fwrite(&STAT[0],sizeof(double),5,stat);
-    fclose(stat);
+  std::cout << "Total time : " << (double)query_time/1000000 << " milliseconds" << std::endl;
+  std::cout << "Search time : " << ((double)query_time/1000000)/noSeq << " milliseconds/pattern (total: " << noSeq << " patterns)" << std::endl;
+  std::cout << "Search time : " << ((double)query_time/1000000)/occ_tot << " milliseconds/occurrence (total: " << occ_tot << " occurrences)" << std::endl;
+  
+  // store some statistics
+  STAT[2] = (double)query_time/1000000; STAT[3] = ((double)query_time/1000000)/noSeq; STAT[4] = ((double)query_time/1000000)/occ_tot;
+  std::string stat_file  = arg.filename + ".stats";
+  FILE * stat = fopen(stat_file.c_str(),"w");
+  fwrite(&STAT[0],sizeof(double),5,stat);
+  fclose(stat);
+}
+
+int main(int argc, char** argv)
+{
+  // translate command line arguments
+  args arg;
+  parseArgs(argc, argv, arg);
+  // compute and store the r-Index of the eBWT
+  if(arg.build){
+    if( arg.verbose ){
+      std::cout << "Computing the eBWT r-index of: " << arg.filename 
+      << " Main bitvector blocksize selected: " << arg.B << "\n";
+      /*if( arg.pfpebwt ){ std::cout << "Reading pfpebwt files\n"; }
+      if( arg.pfpebwt || arg.read_from_stream )
+      {
+        std::cout << "Reading input files from stream\n";
+      }*/
+    }
+    // compute and store the ebwt r-index
+    r_index<>(arg.filename,arg.B,arg.read_from_stream,1,arg.verbose,arg.first,arg.kmer,arg.sa_rate);
+    // store the predecessor structure in plain arrays
+    if(arg.array){ store_array_index(arg.filename, arg.verbose); }
+    // store the memory mapped layout of the ebwt r-index
+    if(arg.mmap){ store_mapped_index(arg.filename, arg.blocks, arg.verbose); }
+  }
+  else if(!arg.check){
+
+    // load the index with the type matching its layout and block size
+    with_index(arg.filename, arg.mmap, [&](auto& idx, uint64_t load){ run_queries(idx, arg, load); });
   }
 
   return 0;
@@ -0,0 +1,195 @@
+/*
+ * Helpers to store data structures in a flat file that can be mapped in
+ * memory with mmap and queried in place.
+ *
+ * Every array is stored after its length and is aligned to 64 bytes, so
+ * that the mapped arrays can be accessed directly without any copy.
+ */
+
+#ifndef MM_FILE_HPP_
+#define MM_FILE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// alignment of the arrays in the mapped file
+#define MM_ALIGN 64
+
+/*
+ * read-only memory mapping of a file
+ */
+class mm_file{
+
+public:
+	mm_file(const std::string &filename){
+		int fd = open(filename.c_str(), O_RDONLY);
+		if(fd < 0){ std::cerr << "Error opening " << filename << ". exiting..." << std::endl; exit(1); }
+		struct stat filestat;
+		if(fstat(fd, &filestat) < 0){ std::cerr << "Error in fstat of " << filename << ". exiting..." << std::endl; exit(1); }
+		length = filestat.st_size;
+		// the mapping is shared, so that concurrent processes share the page cache
+		void *ptr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		if(ptr == MAP_FAILED){ std::cerr << "Error in mmap of " << filename << ". exiting..." << std::endl; exit(1); }
+		close(fd);
+		base = (const uint8_t*)ptr;
+	}
+
+	~mm_file(){
+		if(base != NULL){ munmap((void*)base, length); }
+	}
+
+	mm_file(const mm_file&) = delete;
+	mm_file& operator=(const mm_file&) = delete;
+
+	const uint8_t* data() const { return base; }
+
+	size_t size() const { return length; }
+
+private:
+	// beginning of the mapping
+	const uint8_t *base = NULL;
+	// length of the file
+	size_t length = 0;
+};
+
+/*
+ * sequential reader of a mapped file
+ */
+class mm_reader{
+
+public:
+	mm_reader(const mm_file &f): base(f.data()), length(f.size()) {}
+
+	// read a single value
+	template<class T>
+	T value(){
+		T x;
+		check(sizeof(T));
+		memcpy(&x, base+pos, sizeof(T));
+		pos += sizeof(T);
+		return x;
+	}
+
+	// true if the whole file has been read
+	bool at_end() const { return pos >= length; }
+
+	// return a pointer to an aligned array of n values
+	template<class T>
+	const T* array(size_t n){
+		pos = (pos + MM_ALIGN - 1) / MM_ALIGN * MM_ALIGN;
+		check(n*sizeof(T));
+		const T *ptr = (const T*)(base+pos);
+		pos += n*sizeof(T);
+		return ptr;
+	}
+
+private:
+	// exit if the file is too short
+	void check(size_t n){
+		if(pos + n > length){ std::cerr << "Error, truncated mapped index. exiting..." << std::endl; exit(1); }
+	}
+
+	const uint8_t *base;
+	size_t length;
+	size_t pos = 0;
+};
+
+/*
+ * sequential writer of a mapped file
+ */
+class mm_writer{
+
+public:
+	mm_writer(std::ostream &out_): out(out_) {}
+
+	// write a single value
+	template<class T>
+	void value(const T &x){
+		out.write((const char*)&x, sizeof(T));
+		pos += sizeof(T);
+	}
+
+	// write an aligned array of n values
+	template<class T>
+	void array(const T *ptr, size_t n){
+		static const char zeros[MM_ALIGN] = {0};
+		size_t pad = (MM_ALIGN - pos % MM_ALIGN) % MM_ALIGN;
+		out.write(zeros, pad);
+		if(n > 0){ out.write((const char*)ptr, n*sizeof(T)); }
+		pos += pad + n*sizeof(T);
+	}
+
+	// number of bytes written
+	size_t bytes() const { return pos; }
+
+private:
+	std::ostream &out;
+	size_t pos = 0;
+};
+
+/*
+ * array that either owns its elements or points to a mapped file
+ */
+template<class T>
+class mm_array{
+
+public:
+	mm_array(){}
+
+	mm_array(std::vector<T> &&v): own(std::move(v)) { reset(); }
+
+	mm_array(const mm_array &o): own(o.own), ptr(o.ptr), n(o.n) { if(!own.empty()){ reset(); } }
+
+	mm_array(mm_array &&o): own(std::move(o.own)), ptr(o.ptr), n(o.n) { if(!own.empty()){ reset(); } }
+
+	mm_array& operator=(const mm_array &o){
+		own = o.own; ptr = o.ptr; n = o.n;
+		if(!own.empty()){ reset(); }
+		return *this;
+	}
+
+	mm_array& operator=(mm_array &&o){
+		own = std::move(o.own); ptr = o.ptr; n = o.n;
+		if(!own.empty()){ reset(); }
+		return *this;
+	}
+
+	const T& operator[](size_t i) const { return ptr[i]; }
+
+	const T* data() const { return ptr; }
+
+	size_t size() const { return n; }
+
+	// store the array
+	void write(mm_writer &w) const {
+		w.value(uint64_t(n));
+		w.array(ptr, n);
+	}
+
+	// point the array to the mapped file
+	void map(mm_reader &r){
+		own.clear();
+		n = r.value<uint64_t>();
+		ptr = r.template array<T>(n);
+	}
+
+private:
+	void reset(){ ptr = own.data(); n = own.size(); }
+
+	// owned elements
+	std::vector<T> own;
+	// pointer to the elements
+	const T *ptr = NULL;
+	// number of elements
+	size_t n = 0;
+};
+
+#endif
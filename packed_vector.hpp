@@ -0,0 +1,78 @@
+/*
+ * Bit-packed integer vector that can be stored in a mapped file.
+ *
+ * It replaces sdsl::int_vector<> in the memory mapped index.
+ */
+
+#ifndef PACKED_VECTOR_HPP_
+#define PACKED_VECTOR_HPP_
+
+#include <vector>
+
+#include "sd_vector.hpp"
+#include "mm_file.hpp"
+
+class packed_vector{
+
+public:
+	// empty constructor
+	packed_vector(){}
+	// constructor from an integer vector (e.g. sdsl::int_vector<>)
+	template<class iv_t>
+	packed_vector(iv_t& v){
+		n = v.size();
+		w = v.width();
+		std::vector<uint64_t> words((n*w+63)/64 + 1, 0);
+		for(uint64_t i=0; i<n; ++i){
+			uint64_t x = v[i], b = i*w;
+			words[b/64] |= x << (b%64);
+			if(b%64 + w > 64){ words[b/64+1] |= x >> (64 - b%64); }
+		}
+		bits = mm_array<uint64_t>(std::move(words));
+	}
+
+	uint64_t size(){
+		return n;
+	}
+
+	/*
+	 * return the i-th integer
+	 */
+	uint64_t operator[](uint64_t i){
+		uint64_t b = i*w, off = b%64;
+		uint64_t x = bits[b/64] >> off;
+		if(off + w > 64){ x |= bits[b/64+1] << (64 - off); }
+		return w == 64 ? x : x & ((1ULL << w) - 1);
+	}
+
+	/*
+	 * prefetch the i-th integer
+	 */
+	void prefetch(uint64_t i){
+		__builtin_prefetch(bits.data() + (i*w)/64);
+	}
+
+	/*
+	 * store the structure in a mapped file
+	 */
+	void write_mm(mm_writer &wr) const {
+		wr.value(n); wr.value(w);
+		bits.write(wr);
+	}
+
+	/*
+	 * map the structure from a mapped file
+	 */
+	void map(mm_reader &r){
+		n = r.value<uint64_t>(); w = r.value<uint64_t>();
+		bits.map(r);
+	}
+
+private:
+	// number of integers and their width
+	uint64_t n = 0, w = 0;
+	// packed integers
+	mm_array<uint64_t> bits;
+};
+
+#endif
@@ -1,8 +1,13 @@
 /*
  * Multithread Prefix-free parse implementation to compute the circular PFP of sequence collections.
- * 
+ *
  * This code is adapted from https://github.com/alshai/Big-BWT/blob/master/newscan.hpp
  *
+ * The input file is split at FASTA record boundaries and each thread parses its records
+ * with the same code of the NT version, using its own dictionary and output files.
+ * The dictionaries and the output files are then merged in input order, so that
+ * the output is identical to the one of the NT version. With arg.mem the output
+ * files of the threads are kept in memory.
  */
 
 extern "C" {
@@ -10,212 +15,243 @@ extern "C" {
 }
 #include <vector>
 #include <istream>
-pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-struct Res {
-    size_t tot_char = 0;
-    int us_th = 0;
-};
+#include <sys/stat.h>
 
 // struct shared via mt_parse
 typedef struct {
-  map<uint64_t,word_stats> *wordFreq; // shared dictionary
   Args *arg;       // command line input
+  word_dict wordFreq; // thread local dictionary
   size_t true_start, true_end; // input
-  size_t parsed, words;  // output
-  FILE *parse, *o;
+  size_t sum;      // length of the parsed sequences
+  uint64_t parsed; // output
+  bool stop;       // an invalid char stopped the parsing
+  int num;         // thread number, used for the names of the output files
+  mem_file out[4]; // output files kept in memory
 } mt_data;
 
-// modified from mt_parse to skip newlines and fasta header lines (ie. lines starting with ">")
+// extensions of the output files of the threads
+static const char *thread_exts[] = {EXTPARS0, EXTOFF0, EXTLAST, EXTFIRST};
+
+// open the k-th output file of thread d for writing
+static FILE *open_thread_file(mt_data *d, int k)
+{
+  if(d->arg->mem) return d->out[k].writer();
+  return open_aux_file_num(d->arg->inputFileName.c_str(),thread_exts[k],d->num,"wb");
+}
+
+// open the k-th output file of thread d for reading
+static FILE *read_thread_file(mt_data *d, int k)
+{
+  if(d->arg->mem) return d->out[k].reader();
+  return open_aux_file_num(d->arg->inputFileName.c_str(),thread_exts[k],d->num,"rb");
+}
+
+// delete the k-th output file of thread d
+static void remove_thread_file(mt_data *d, int k)
+{
+  if(d->arg->mem) { d->out[k].clear(); return; }
+  string name = d->arg->inputFileName + "." + to_string(d->num) + "." + thread_exts[k];
+  if(remove(name.c_str())!=0) die("Error removing thread file");
+}
+
+// parse the FASTA records in [true_start, true_end) of the input file
 void *cyclic_mt_parse_fasta(void *dx)
 {
   // extract input data
   mt_data *d = (mt_data *) dx;
   Args *arg = d->arg;
-  map<uint64_t,word_stats> *wordFreq = d-> wordFreq;
 
   if(arg->verbose>1)
     printf("Scanning from %ld, size %ld as a FASTA record\n",d->true_start,d->true_end-d->true_start);
-  if(d->true_end-d->true_start == 0) return NULL;
 
-  // open input file
-  ifstream f(arg->inputFileName);
-  if(!f.is_open()) {
-    perror(__func__);
-    throw new std::runtime_error("Cannot open file " + arg->inputFileName);
-  }
-  
-  // prepare for parsing
-  f.seekg(d->true_start); // move to the beginning of assigned region
+  // open the thread output files
+  FILE *parse_file = open_thread_file(d,0);
+  FILE *offset_file = open_thread_file(d,1);
+  FILE *last_file = open_thread_file(d,2);
+  FILE *first_file = open_thread_file(d,3);
+
+  // open the input file and move to the beginning of assigned region
+  range_file rf;
+  rf.fp = gzopen(arg->inputFileName.c_str(), "r");
+  if(rf.fp == NULL) die("Cannot open input file");
+  if(gzseek(rf.fp, d->true_start, SEEK_SET) < 0) die("Error seeking input file");
+  rf.left = d->true_end - d->true_start;
+  kseq_t *seq = kseq_init(&rf);
+
   KR_window krw(arg->w);
-  uint8_t c, pc = '\n'; string word = ""; string fword = ""; string final_word = "";
-  uint64_t start_char = 0;
-  bool first_trigger = 0;
-  
-  // skip the header
-  uint64_t current_pos = d->true_start; uint64_t i=0;
-  // step when we find the newline
-  while((c != '\n')){
-      c = f.get();
-      current_pos++;
-  }
-  pc = c;
-  //assert(is_valid_base(std::toupper(f.peek())));
-  // parse the sequence
-  while( (pc != EOF) && current_pos <= d->true_end) {
-      c = f.get();
-      current_pos++;
-      c = std::toupper(c);
-      //if(is_valid_base(c)){
-      if(c > 64){ // A is 65 in ascii table. 
-          if(c<= Dollar || c> 90) die("Invalid char found in input file. Exiting...");
-          word.append(1, c);
-          if(first_trigger == 0){fword.append(1, c);}
-          uint64_t hash = krw.addchar(c);
-            if (hash%arg->p==0 && krw.current == arg->w){
-                if(first_trigger==0){
-                    first_trigger = 1, start_char = i;
-                    if(fwrite(&start_char,sizeof(start_char),1,d->o)!=1) die("offset write error");
-                    word.erase(0,word.size() - arg->w);
-                }
-                else{
-                    save_update_word(word,arg->w,*wordFreq,d->parse,0);
-                    d->words++;
-                }
-            }
-          pc = c; i++;
-      }
-      else{ 
-        if(c == '>' || c == EOF || current_pos >= d->true_end){
-            d->parsed += krw.tot_char;
-            for (size_t i = 0; i < arg->w - 1; i++) {
-                c = fword[i];
-                word.append(1, c);
-                if(first_trigger == 0){fword.append(1, c);}
-                uint64_t hash = krw.addchar(c);
-                if(hash%arg->p==0){
-                    if(first_trigger==0){
-                        first_trigger = 1, start_char = krw.tot_char;
-                        if(fwrite(&start_char,sizeof(start_char),1,d->o)!=1) die("offset write error");
-                        word.erase(0,word.size() - arg->w);
-                    }else{
-                        save_update_word(word,arg->w,*wordFreq,d->parse,0);
-                        d->words++;}
-                }
-            }
-            if(first_trigger==0) { cerr << "No trigger strings found. Please use '--reads' flag. Exiting..." << endl; exit(1); }
-            final_word = word + fword.erase(0,arg->w - 1);
-            save_update_word(final_word,arg->w,*wordFreq,d->parse,1);
-            d->words++; 
-            krw.reset();
-            first_trigger = 0; start_char=0; i=0;
-            word = fword = final_word = "";
-            while(  ((c = f.get()) != EOF) && current_pos <= d->true_end ){
-                current_pos++;
-                if(c=='\n'){break;}
-             }
-            pc = c;
-        }
+  while (kseq_read(seq) >= 0) {
+      if(!parse_sequence(*arg,seq,krw,d->wordFreq,parse_file,offset_file,last_file,first_file,d->sum,d->parsed)) {
+          d->stop = true; break;
       }
+  }
+  kseq_destroy(seq);
+  gzclose(rf.fp);
+
+  if(fclose(parse_file)!=0) die("Error closing parse file");
+  if(fclose(offset_file)!=0) die("Error closing offset file");
+  if(fclose(last_file)!=0) die("Error closing last file");
+  if(fclose(first_file)!=0) die("Error closing first file");
+  return NULL;
+}
+
+// append the k-th output file of thread d to out and delete it
+static void append_thread_file(mt_data *d, int k, FILE *out)
+{
+  FILE *in = read_thread_file(d,k);
+  vector<char> buf(1<<20);
+  size_t s;
+  while((s = fread(buf.data(),1,buf.size(),in)) > 0)
+    if(fwrite(buf.data(),1,s,out)!=s) die("Error merging thread files");
+  if(fclose(in)!=0) die("Error closing thread file");
+  remove_thread_file(d,k);
+}
+
+// as append_thread_file, for a file of SABYTES positions that are shifted by base
+static void append_thread_positions(mt_data *d, int k, uint64_t base, FILE *out)
+{
+  FILE *in = read_thread_file(d,k);
+  uint64_t pos = 0;
+  while(fread(&pos,SABYTES,1,in)==1) {
+    uint64_t x = pos + base;
+    if(fwrite(&x,SABYTES,1,out)!=1) die("Error merging thread files");
+    pos = 0;
+  }
+  if(fclose(in)!=0) die("Error closing thread file");
+  remove_thread_file(d,k);
+}
+
+// add the words of the shard src to the shard dst
+static void merge_word_shard(word_dict::table& dst, word_dict::table& src)
+{
+  if(dst.size()==0) { std::swap(dst, src); return; }
+  for(auto& x: src) {
+    bool inserted;
+    word_stats& ws = dst.insert(x.first, inserted);
+    if(inserted) { ws = std::move(x.second); continue; }
+    occ_int_t occ = ws.occ + x.second.occ;
+    if(occ < ws.occ) {
+      cerr << "Emergency exit! Maximum # of occurence of dictionary word (";
+      cerr<< MAX_WORD_OCC << ") exceeded\n";
+      exit(1);
     }
-  
-  f.close(); 
+    if(ws.str != x.second.str) {
+      cerr << "Emergency exit! Hash collision for strings:\n";
+      cerr << ws.str << "\n  vs\n" <<  x.second.str << endl;
+      exit(1);
+    }
+    ws.occ = occ;
+  }
+  src.clear();
+}
+
+// struct shared via merge_word_freq
+typedef struct {
+  word_dict *wordFreq;   // merged dictionary
+  vector<mt_data> *td;   // thread dictionaries
+  int ntd;               // number of thread dictionaries to merge
+  int first, step;       // shards merged by this thread
+} merge_data;
+
+// merge the shards first, first+step, ... of the thread dictionaries
+void *merge_word_freq(void *dx)
+{
+  merge_data *m = (merge_data *) dx;
+  for(int s=m->first; s<DICT_SHARDS; s+=m->step)
+    for(int i=0; i<m->ntd; i++)
+      merge_word_shard(m->wordFreq->shard(s), (*m->td)[i].wordFreq.shard(s));
   return NULL;
 }
 
 // prefix free parse of file fnam. w is the window size, p is the modulus
 // use a KR-hash as the word ID that is written to the parse file
-Res parallel_parse_fasta(Args& arg, map<uint64_t,word_stats>& wf)
+uint64_t parallel_parse_fasta(Args& arg, word_dict& wf, first_pass_files& out)
 {
     assert(arg.th>0);
-    pthread_t t[arg.th];
-    mt_data td[arg.th];
-    // scan file for start positions and execute threads
-    FILE* fp = fopen(arg.inputFileName.c_str(), "r");
-    if (fp == NULL) {
-      throw new std::runtime_error("Cannot open input file " +arg.inputFileName);
+    // a compressed input cannot be split
+    gzFile gz = gzopen(arg.inputFileName.c_str(), "r");
+    if(gz == NULL) die("Cannot open input file");
+    gzgetc(gz);
+    bool direct = gzdirect(gz);
+    gzclose(gz);
+    if(!direct) {
+      cout << "Compressed input, parsing with one thread\n";
+      return firstpass_fasta_NT(arg, wf, out);
     }
-    fseek(fp, 0L, SEEK_END);
-    size_t size = ftell(fp);
-    rewind(fp);
-    std::vector<size_t> th_sts(arg.th+1);
-    th_sts[0] = 1; th_sts[arg.th] = size;
+    struct stat st;
+    if(stat(arg.inputFileName.c_str(), &st)!=0) die("Cannot stat input file");
+    size_t size = st.st_size;
+
+    // this loop scans the Fasta file in order to properly divide it up
+    // for the threads: each thread starts at a '>' at the beginning of a line
+    FILE* fp = fopen(arg.inputFileName.c_str(), "r");
+    if (fp == NULL) die("Cannot open input file");
+    std::vector<size_t> th_sts(1,0);
     for (int i = 1; i < arg.th; ++i) {
-      th_sts[i] = (size_t) (size / arg.th) * i;
+      size_t start = max(th_sts.back()+1, (size_t) (size / arg.th) * i);
+      if(start >= size) break;
+      fseek(fp, start-1, SEEK_SET);
+      int pc = fgetc(fp), c;
+      size_t j = start;
+      while((c = fgetc(fp)) != EOF && !(c == '>' && pc == '\n')) { pc = c; ++j; }
+      if(c == EOF) break;
+      th_sts.push_back(j);
     }
-  
+    th_sts.push_back(size);
+    fclose(fp);
+    int nt = th_sts.size()-1;
+
     if(arg.verbose) {
-    cout << "Thread: " << arg.th << endl;
+    cout << "Thread: " << nt << endl;
     cout << "Total size: " << size << endl;
     cout << "------------------------" << endl; }
-  
-    uint8_t c = fgetc(fp); size_t hp = 1; bool sf = 0;
-    size_t tstart = 1, tend = 1;
-    size_t nt = 1;
-    // this loop scans the Fasta file in order to properly divide it up
-    // for the threads, so that they don't accidently start in a ">" header.
-    // As soon as a proper start and end position has been found, execute the thread 
-    for(int i=1;i<th_sts.size()-1;i++){
-        
-        size_t start = th_sts[i];
-        size_t end = th_sts[i+1];
-        fseek(fp, start, SEEK_SET);
-        //cout << "scanning " << start << " - " << end << endl;
-        for(size_t j=start; j<end; ++j){
-            c = fgetc(fp);
-            if(c == '>'){hp=j;sf=1;break;}
-        }
-        
-        if(sf==1){
-            sf=0;
-            //tend = hp-1;
-            tend = hp;
-            // prepare and execute thread j-1
-            td[nt-1].wordFreq = &wf;
-            td[nt-1].arg = &arg;
-            td[nt-1].true_start = tstart;
-            td[nt-1].true_end = tend;
-            td[nt-1].words = 0;
-            td[nt-1].parsed = 0;
-            assert(td[nt-1].true_end <=size);
-            td[nt-1].parse = open_aux_file_num(arg.inputFileName.c_str(),EXTPARS0,nt-1,"wb");
-            td[nt-1].o = open_aux_file_num(arg.inputFileName.c_str(),EXTOFF0,nt-1,"wb");
-            xpthread_create(&t[nt-1],NULL,&cyclic_mt_parse_fasta,&td[nt-1],__LINE__,__FILE__);
-            nt++;
-            tstart = hp+1;
-        }
+
+    // execute the threads
+    pthread_t t[nt];
+    vector<mt_data> td(nt);
+    for(int i=0;i<nt;i++) {
+      td[i].arg = &arg;
+      td[i].true_start = th_sts[i];
+      td[i].true_end = th_sts[i+1];
+      td[i].sum = 0;
+      td[i].parsed = 0;
+      td[i].stop = false;
+      td[i].num = i;
+      xpthread_create(&t[i],NULL,&cyclic_mt_parse_fasta,&td[i],__LINE__,__FILE__);
     }
-    
-    tend = size;
-    td[nt-1].wordFreq = &wf;
-    td[nt-1].arg = &arg;
-    td[nt-1].true_start = tstart;
-    td[nt-1].true_end = tend;
-    td[nt-1].words = 0;
-    td[nt-1].parsed = 0;
-    assert(td[nt-1].true_end <=size);
-    td[nt-1].parse = open_aux_file_num(arg.inputFileName.c_str(),EXTPARS0,nt-1,"wb");
-    td[nt-1].o = open_aux_file_num(arg.inputFileName.c_str(),EXTOFF0,nt-1,"wb");
-    xpthread_create(&t[nt-1],NULL,&cyclic_mt_parse_fasta,&td[nt-1],__LINE__,__FILE__);
-    
-    // wait for the threads to finish (in order) and close output files
-    size_t tot_char=0;
+    for(int i=0;i<nt;i++)
+      xpthread_join(t[i],NULL,__LINE__,__FILE__);
+
+    // merge the thread files and dictionaries in input order
+    uint64_t tot_char = 0, sum = 0;
+    bool stop = false; int ntd = 0;
     for(int i=0;i<nt;i++) {
-      xpthread_join(t[i],NULL,__LINE__,__FILE__); 
-      if(arg.verbose) {
-      cout << "s:" << td[i].true_start << "  e:" << td[i].true_end << "  pa:";
+      if(arg.verbose)
+        cout << "s:" << td[i].true_start << "  e:" << td[i].true_end << "  pa:" << td[i].parsed << endl;
+      // the NT version does not read past an invalid char
+      if(!stop) {
+        append_thread_file(&td[i],0,out.parse);
+        append_thread_file(&td[i],1,out.offset);
+        append_thread_positions(&td[i],2,sum,out.last);
+        append_thread_positions(&td[i],3,sum,out.first);
+        ntd++;
+        tot_char += td[i].parsed;
+        sum += td[i].sum;
+        stop = td[i].stop;
+      }
+      else {
+        for(int k=0;k<4;k++) remove_thread_file(&td[i],k);
       }
-    // close thread-specific output files
-    fclose(td[i].parse);
-    fclose(td[i].o);
-    if(td[i].words>0) {
-      // extra check
-      assert(td[i].parsed>arg.w);
-      tot_char += td[i].parsed;
     }
-    else assert(i>0); // the first thread must produce some words 
+    if(fwrite(&sum,SABYTES,1,out.first)!=1) die("first write error");
+    // merge the dictionaries of the first ntd threads, each thread merges a subset of the shards
+    vector<merge_data> md(nt);
+    for(int i=0;i<nt;i++) {
+      md[i].wordFreq = &wf; md[i].td = &td; md[i].ntd = ntd;
+      md[i].first = i; md[i].step = nt;
+      xpthread_create(&t[i],NULL,&merge_word_freq,&md[i],__LINE__,__FILE__);
     }
-    fclose(fp);
-    Res res; res.tot_char = tot_char; res.us_th = nt;
-    return res;
+    for(int i=0;i<nt;i++)
+      xpthread_join(t[i],NULL,__LINE__,__FILE__);
+
+    return tot_char;
 }
@@ -0,0 +1,475 @@
+/*
+ * PFP parse implementation to compute the circular Prefix-free parse of a collection of sequences.
+ * 
+ * This code is adapted from https://github.com/alshai/Big-BWT/blob/master/newscan.cpp
+ *
+ * The parsing functions write to the FILE streams given by the caller: circpfp.x
+ * uses the files on disk, er-build uses memory streams.
+ */
+
+#ifndef CIRCPFP_CORE_HPP
+#define CIRCPFP_CORE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ctime>
+#include <map>
+#include <set>
+#include <assert.h>
+#include <errno.h>
+#include <zlib.h>
+#ifdef GZSTREAM
+#include <gzstream.h>
+#endif
+extern "C" {
+#include "utils.h"
+#include "xerrors.h"
+}
+#include "kseq.h"
+#include "phrase_dict.hpp"
+
+// input file read by kseq, limited to the bytes left to read
+// when the input is split among the threads
+struct range_file {
+  gzFile fp;
+  uint64_t left;
+};
+
+static int range_read(range_file *f, void *buf, unsigned len)
+{
+  if(f->left < len) len = f->left;
+  if(len == 0) return 0;
+  int r = gzread(f->fp, buf, len);
+  if(r > 0) f->left -= r;
+  return r;
+}
+
+KSEQ_INIT(range_file*, range_read)
+
+using namespace std;
+using namespace __gnu_cxx;
+
+// =============== algorithm limits ===================
+// maximum number of distinct words
+#define MAX_DISTINCT_WORDS (INT32_MAX -1)
+typedef uint32_t word_int_t;
+// maximum number of occurrences of a single word
+#define MAX_WORD_OCC (UINT32_MAX)
+typedef uint32_t occ_int_t;
+typedef pair <uint32_t,uint32_t> p;
+
+// struct containing command line parameters and other globals
+struct Args {
+   string inputFileName = "";
+   size_t w = 10;            // sliding window size and its default
+   size_t p = 100;           // modulus for establishing stopping w-tuples
+   int th=0;              // number of helper threads
+   int verbose=0;         // verbosity level
+   bool mem=false;        // keep the files of the threads in memory
+};
+
+struct word_stats {
+  string str;  // parse phrase
+  occ_int_t occ;  // no. of phrases
+  word_int_t rank=0; // rank of the phrase
+};
+
+// dictionary of the parse phrases keyed by their KR hash
+typedef phrase_dict<word_stats> word_dict;
+
+// files written by the first pass: parse, offsets, last and first positions
+struct first_pass_files {
+  FILE *parse, *offset, *last, *first;
+};
+
+// buffer written through a memory stream, used to keep the parse files in memory
+struct mem_file {
+  char *buf = NULL;
+  size_t size = 0;
+
+  mem_file() {}
+  mem_file(const mem_file&) = delete;
+  ~mem_file() { free(buf); }
+
+  // open the buffer for writing, its content is available after fclose
+  FILE *writer() {
+    free(buf); buf = NULL; size = 0;
+    FILE *f = open_memstream(&buf, &size);
+    if(f==NULL) die("open_memstream error");
+    return f;
+  }
+  // open the buffer for reading
+  FILE *reader() {
+    FILE *f = fmemopen(buf, size, "rb");
+    if(f==NULL) die("fmemopen error");
+    return f;
+  }
+  // free the buffer
+  void clear() { free(buf); buf = NULL; size = 0; }
+};
+
+struct KR_window {
+  int wsize;
+  int current;
+  int *window;
+  int asize;
+  const uint64_t prime = 1999999973;
+  uint64_t hash;
+  uint64_t tot_char;
+  uint64_t asize_pot;   // asize^(wsize-1) mod prime
+
+  KR_window(int w): wsize(w) {
+    asize = 256;
+    asize_pot = 1;
+    for(int i=1;i<wsize;i++)
+      asize_pot = (asize_pot*asize) % prime; // ugly linear-time power algorithm
+    // alloc and clear window
+    window = new int[wsize];
+    reset();
+  }
+
+  // init window, hash, and tot_char
+  void reset() {
+    for(int i=0;i<wsize;i++) window[i]=0;
+    // init hash value and related values
+    hash=tot_char=current=0;
+  }
+
+  uint64_t addchar(int c) {
+    int k = tot_char++ % wsize;
+    current++;
+    current = min(wsize,current);
+    // complex expression to avoid negative numbers
+    hash += (prime - (window[k]*asize_pot) % prime); // remove window[k] contribution
+    hash = (asize*hash + c) % prime;      //  add char i
+    window[k]=c;
+    // cerr << get_window() << " ~~ " << window << " --> " << hash << endl;
+    return hash;
+  }
+  // debug only
+  string get_window() {
+    string w = "";
+    int k = (tot_char-1) % wsize;
+    for(int i=k+1;i<k+1+wsize;i++)
+      w.append(1,window[i%wsize]);
+    return w;
+  }
+
+  ~KR_window() {
+    delete[] window;
+  }
+
+};
+
+
+// compute 64-bit KR hash of a string
+// to avoid overflows in 64 bit aritmethic the prime is taken < 2**55
+uint64_t kr_hash(string s) {
+    uint64_t hash = 0;
+    //const uint64_t prime = 3355443229;     // next prime(2**31+2**30+2**27)
+    const uint64_t prime = 27162335252586509; // next prime (2**54 + 2**53 + 2**47 + 2**13)
+    for(size_t k=0;k<s.size();k++) {
+      int c = (unsigned char) s[k];
+      assert(c>=0 && c< 256);
+      hash = (256*hash + c) % prime;    //  add char k
+    }
+    return hash;
+}
+
+// save current word in the freq map and update it leaving only the
+// last minsize chars which is the overlap with next word
+static void save_update_word(string& w, unsigned int minsize, word_dict& freq, FILE *tmp_parse_file, bool last_word)
+{
+  assert(w.size() >= minsize);
+  if(w.size() <= minsize) return;
+  // get the hash value and write it to the temporary parse file
+  uint64_t hash = kr_hash(w);
+  if(fwrite(&hash,sizeof(hash),1,tmp_parse_file)!=1) die("parse write error");
+  if(last_word){
+      string lw(minsize,Dollar);
+      uint64_t hash = kr_hash(lw);
+      if(fwrite(&hash,sizeof(hash),1,tmp_parse_file)!=1) die("parse write error");
+  } 
+
+  // update frequency table for current hash
+  bool inserted;
+  word_stats& ws = freq.insert(hash, inserted);
+  if(inserted) {
+      ws.occ = 1; // new hash
+      ws.str = w;
+  }
+  else {
+      ws.occ += 1; // known hash
+      if(ws.occ <=0) {
+        cerr << "Emergency exit! Maximum # of occurence of dictionary word (";
+        cerr<< MAX_WORD_OCC << ") exceeded\n";
+        exit(1);
+      }
+      if(ws.str != w) {
+        cerr << "Emergency exit! Hash collision for strings:\n";
+        cerr << ws.str << "\n  vs\n" <<  w << endl;
+        exit(1);
+      }
+  }
+  // keep only the overlapping part of the window
+  w.erase(0,w.size() - minsize);
+}
+
+// compute the circular prefix free parse of the sequence seq, sum is the total length of the
+// previous sequences and is updated, the parse, offsets, last and first positions are
+// written to the given files. Return false if an invalid char stops the parsing
+static bool parse_sequence(Args& arg, kseq_t *seq, KR_window& krw, word_dict& wordFreq,
+                           FILE *parse_file, FILE *offset_file, FILE *last_file, FILE *first_file,
+                           size_t& sum, uint64_t& total_char)
+{
+    uint8_t c;
+    size_t i = 0, j = 0;
+    size_t l = seq->seq.l;
+    //cout << "length: " << l << endl;
+    if(fwrite(&sum,SABYTES,1,first_file)!=1) die("first write error");
+    bool f_trg = 0;
+    uint64_t start_char = 0, last_pos = 0;
+    string first_word(""); string next_word(""); 
+    for (i = 0; i < seq->seq.l; ++i) {
+        c = std::toupper(seq->seq.s[i]);
+        if (c <= Dollar) {cerr << "Invalid char found in input file: no additional chars will be read\n"; break;}
+        next_word.append(1, c);
+        uint64_t hash = krw.addchar(c);
+        if (hash%arg.p == 0 && krw.current == arg.w) {
+            start_char = i; f_trg = 1;
+            last_pos = (i + sum);
+            if(fwrite(&start_char,sizeof(start_char),1,offset_file)!=1) die("offset write error");
+            first_word = string(next_word);
+            next_word.erase(0,next_word.size() - arg.w); break;
+        }
+    }
+    for (i = i+1; i < seq->seq.l; ++i){
+        c = std::toupper(seq->seq.s[i]);
+        next_word.append(1, c);
+        uint64_t hash = krw.addchar(c);
+        if (hash%arg.p==0) {
+            save_update_word(next_word,arg.w,wordFreq,parse_file,0);
+            j = i + sum;
+            //cout << "(" << j << " 1) ";
+            if(fwrite(&j,SABYTES,1,last_file)!=1) die("last write error");
+        }
+    }
+       
+    total_char += krw.tot_char;
+    if(f_trg) { assert(first_word.size() >= arg.w); }
+    // check if exist a trigger string in final word
+    if(!f_trg) first_word = next_word.substr(0,arg.w - 1);
+    for (i = 0; i < arg.w - 1; i++) {
+        c = first_word[i];
+        next_word.append(1, c);
+        uint64_t hash = krw.addchar(c);
+        if(hash%arg.p==0){
+            if(!f_trg) { start_char = krw.tot_char; f_trg = 1;
+                         if(fwrite(&start_char,sizeof(start_char),1,offset_file)!=1) die("offset write error"); 
+                         first_word = string(next_word);
+                         next_word.erase(0,next_word.size() - arg.w); }
+            else{
+              // if it is not the first trigger string
+              save_update_word(next_word,arg.w,wordFreq,parse_file,0);
+              j = i + sum;
+              //cout << "(" << j << " 2) ";
+              if(fwrite(&j,SABYTES,1,last_file)!=1) die("last write error");
+            }
+        }
+    }
+    if(!f_trg) { cerr << "No trigger strings found. Please descrease w and p values. Exiting... " << endl; exit(1); }
+    // join first and last word
+    string final_word = next_word + first_word.erase(0,arg.w-1);
+    save_update_word(final_word,arg.w,wordFreq,parse_file,1);
+    //cout << "(" << last_pos << " 3) ";
+    if(fwrite(&last_pos,SABYTES,1,last_file)!=1) die("last write error");
+    sum += l;
+    krw.reset();
+    return c > Dollar;
+}
+
+// compute the circular prefix free parse of fname, w is the window size, p is the modulus
+// use a KR-hash as the word ID that is immediately written to the parse file
+uint64_t firstpass_fasta_NT(Args& arg, word_dict& wordFreq, first_pass_files& out)
+{
+    //open a, possibly compressed, input file
+    string fnam = arg.inputFileName;
+  
+    // initialize the sliding window
+    KR_window krw(arg.w);
+    uint64_t total_char = 0;
+    // open the input file
+    range_file rf;
+    kseq_t *seq;
+    size_t sum = 0;
+    rf.fp = gzopen(fnam.c_str(), "r");
+    if(rf.fp == NULL) die("Cannot open input file");
+    rf.left = UINT64_MAX;
+    seq = kseq_init(&rf);
+    // interate over all sequences
+    while (kseq_read(seq) >= 0) {
+        if(!parse_sequence(arg,seq,krw,wordFreq,out.parse,out.offset,out.last,out.first,sum,total_char)) break;
+    }
+    if(fwrite(&sum,SABYTES,1,out.first)!=1) die("first write error");
+    kseq_destroy(seq);
+    gzclose(rf.fp);
+
+    return total_char;
+}
+
+#ifndef NOTHREADS
+#include "circpfp.hpp"
+#endif
+
+// parse the input file with arg.th threads, the first pass files are written to out.
+// Return the number of parsed characters
+uint64_t first_pass(Args& arg, word_dict& wordFreq, first_pass_files& out)
+{
+    uint64_t totChar = 0; // tot characters seen
+    try{
+        if(arg.th<=1){totChar = firstpass_fasta_NT(arg,wordFreq,out);}
+        else
+        {
+            #ifdef NOTHREADS
+            cerr << "Sorry, this is the no-threads executable and you requested " << arg.th << " threads\n";
+            exit(1);
+            #else
+            // the parse files of the threads are merged, as in the NT version
+            totChar = parallel_parse_fasta(arg, wordFreq, out);
+            #endif
+        }
+    }
+    catch(const std::bad_alloc&) {
+    cout << "Out of memory (parsing phase)... emergency exit\n";
+    die("bad alloc exception");
+    }
+
+    uint64_t totDWord = wordFreq.size();
+    cout << "Total input symbols: " << totChar << endl;
+    cout << "Found " << totDWord << " distinct words" <<endl;
+    // check # distinct words
+    if(totDWord>MAX_DISTINCT_WORDS) {
+      cerr << "Emergency exit! The number of distinc words (" << totDWord << ")\n";
+      cerr << "is larger than the current limit (" << MAX_DISTINCT_WORDS << ")\n";
+      exit(1);
+    }
+    return totChar;
+}
+
+// given the sorted dictionary and the frequency map write the dictionary and occ files
+// also compute the 1-based rank for each hash
+void writeDictOcc(Args &arg, word_dict &wfreq, vector<const string *> &sortedDict, FILE *fdict, FILE *focc)
+{
+  assert(sortedDict.size() == wfreq.size());
+
+  word_int_t wrank = 1; // current word rank (1 based)
+  for(auto x: sortedDict) {
+    const char *word = (*x).data();       // current dictionary word
+    int offset=0; size_t len = (*x).size();  // offset and length of word
+    assert(len>(size_t)arg.w);
+    size_t s = fwrite(word,1,len, fdict);
+    if(s!=len) die("Error writing to DICT file");
+    if(fputc(EndOfWord,fdict)==EOF) die("Error writing EndOfWord to DICT file");
+    uint64_t hash = kr_hash(*x);
+    auto& wf = wfreq.at(hash);
+    assert(wf.occ>0);
+    s = fwrite(&wf.occ,sizeof(wf.occ),1, focc);
+    if(s!=1) die("Error writing to OCC file");
+    assert(wf.rank==0);
+    wf.rank = wrank++;
+  }
+  if(fputc(EndOfDict,fdict)==EOF) die("Error writing EndOfDict to DICT file");
+}
+
+// function used to compare two string pointers
+bool pstringCompare(const string *a, const string *b)
+{
+  return *a <= *b;
+}
+
+// sort the dictionary and write the dictionary and occ files
+void write_dictionary(Args &arg, word_dict &wordFreq, FILE *fdict, FILE *focc)
+{
+    uint64_t totDWord = wordFreq.size();
+    // create array of dictionary words
+    vector<const string *> dictArray;
+    dictArray.reserve(totDWord);
+    // fill array
+    uint64_t sumLen = 0;
+    uint64_t totWord = 0;
+    for (auto& x: wordFreq) {
+      sumLen += x.second.str.size();
+      totWord += x.second.occ;
+      dictArray.push_back(&x.second.str);
+    }
+    assert(dictArray.size()==totDWord);
+    cout << "Sum of lenghts of dictionary words: " << sumLen << endl;
+    cout << "Total number of words: " << totWord << endl;
+    // sort dictionary
+    sort(dictArray.begin(), dictArray.end(),pstringCompare);
+    // write plain dictionary and occ file, also compute rank for each hash
+    cout << "Writing plain dictionary and occ file\n";
+    writeDictOcc(arg, wordFreq, dictArray, fdict, focc);
+}
+
+// remap the first pass parse oldp and offsets moff to the ranks of the phrases
+void remapParse(Args &arg, word_dict &wfreq, FILE *moldp, FILE *moff, FILE *newp, FILE *newoff, FILE *strt, FILE *fchar)
+{
+  // recompute occ as an extra check
+  vector<occ_int_t> occ(wfreq.size()+1,0); // ranks are zero based
+  uint64_t hash, phash, fc;
+  uint64_t start = 0, len = 0;
+  string separator(arg.w,Dollar);
+  uint64_t hash_sep = kr_hash(separator);
+  set<p> startChr;
+
+  while(true) {
+    size_t s = fread(&hash,sizeof(hash),1,moldp);
+    if(s==0) break;
+    if(s!=1) die("Unexpected parse EOF");
+    if(hash != hash_sep) {
+        len++;
+        word_int_t rank = wfreq.at(hash).rank;
+        occ[rank]++;
+        phash = hash;
+        s = fwrite(&rank,sizeof(rank),1,newp);
+        if(s!=1) die("Error writing to new parse file"); 
+    }
+    else{
+        s = fwrite(&start,sizeof(start),1,strt);
+        if(s!=1) die("Error writing to start file");
+        start += len;
+        len=0;
+        s = fread(&fc,sizeof(fc),1,moff);
+        if(s!=1) die("Unexpected offset EOF");
+        word_int_t rank = wfreq.at(phash).rank;
+        uint64_t len = wfreq.at(phash).str.length();
+        uint32_t off = uint32_t(len-fc-1);
+        s = fwrite(&off,sizeof(off),1,newoff);
+        if(s!=1) die("Error writing to new offset file");
+        p st = p(rank,off);
+        //if(startFreq.find(st)==startFreq.end()){
+        //    startFreq[st] = 1;
+        //    }else{startFreq[st]+=1;}
+        if(startChr.find(st)==startChr.end()){ startChr.insert(st); }    
+    }
+  }
+
+  for (auto& x: startChr) {
+      if(fwrite(&x,sizeof(x),1,fchar)!=1) die("error writing to first char file");
+  }
+    
+  // check old and recomputed occ coincide
+  for(auto& x : wfreq)
+    assert(x.second.occ == occ[x.second.rank]);
+}
+
+#endif /* CIRCPFP_CORE_HPP */
+
@@ -29,6 +29,8 @@
 #include <queue>
 #include <algorithm>
 #include <assert.h>
+#include <cstring>
+#include <cerrno>
 
 #include <sys/time.h>
 
@@ -185,6 +187,8 @@ void read_file(const char *filename, T*& ptr, size_t& length){
     fclose(fd);
 }
 
+#ifndef READ_FILE_VECTOR_
+#define READ_FILE_VECTOR_
 template<typename T>
 void read_file(const char *filename, std::vector<T>& ptr){
     struct stat filestat;
@@ -208,6 +212,7 @@ void read_file(const char *filename, std::vector<T>& ptr){
 
     fclose(fd);
 }
+#endif
 
 template<typename T>
 void read_fasta_file(const char *filename, std::vector<T>& v){
@@ -230,6 +235,79 @@ void read_fasta_file(const char *filename, std::vector<T>& v){
   	fclose(fd);
 }
 
+// Block buffered writer of a binary file: the data is copied in a large buffer
+// that is written with a single write() when it is full. The file must be closed
+// with close(), that reports the errors of the last write
+class block_writer{
+public:
+    block_writer(){}
+    block_writer(const block_writer&) = delete;
+    block_writer& operator=(const block_writer&) = delete;
+    // best effort flush of a file that was not closed (e.g. during unwinding),
+    // the errors are ignored
+    ~block_writer(){
+        if(fd < 0) return;
+        size_t done = 0;
+        while(done < used){
+            ssize_t w = ::write(fd, &buf[done], used - done);
+            if(w < 0 && errno == EINTR) continue;
+            if(w <= 0) break;
+            done += w;
+        }
+        ::close(fd);
+    }
+
+    void open(std::string filename, size_t buf_size = (1<<22)){
+        if((fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+            error("open() file " + filename + " failed");
+        name = filename;
+        buf.resize(buf_size);
+        used = 0;
+    }
+
+    // write the k least significant bytes of x
+    inline void put(uint64_t x, size_t k){
+        if(used + k > buf.size()) flush();
+        memcpy(&buf[used], &x, k);
+        used += k;
+    }
+
+    // write n copies of the byte c
+    void fill(uint8_t c, size_t n){
+        while(n > 0){
+            if(used == buf.size()) flush();
+            size_t l = std::min(n, buf.size() - used);
+            memset(&buf[used], c, l);
+            used += l; n -= l;
+        }
+    }
+
+    // write the content of the buffer to the file
+    void flush(){
+        size_t done = 0;
+        while(done < used){
+            ssize_t w = ::write(fd, &buf[done], used - done);
+            if(w < 0 && errno == EINTR) continue;
+            if(w < 0) error("write() file " + name + " failed");
+            done += w;
+        }
+        used = 0;
+    }
+
+    void close(){
+        if(fd < 0) return;
+        flush();
+        if(::close(fd) != 0) error("close() file " + name + " failed");
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+    std::string name;
+    std::vector<char> buf;
+    size_t used = 0;
+};
+
 
 //*********************** Time resources ***************************************
 
@@ -6,6 +6,13 @@
  * from https://github.com/felipelouza/gsa-is/blob/master/gsacak.c which is an implementation
  * of the GSACA-K algorithm.
  *
+ * With th > 1 threads the bucket counting is split among the threads, and the induce
+ * stages scan SA in blocks: the threads first compute in parallel the suffix induced by
+ * each entry of the block (the random accesses to s and b_s), then the block is scanned
+ * sequentially updating the buckets, so that SA is the same of the sequential version.
+ *
+ * With dense the sequence boundaries are queried during the sorting with a plain bitvector
+ * and the array of the starting positions, instead of the rank and select on the sd_vector.
  */
 // This is the sample code for the SA-IS algorithm presented in
 // our article "Two Efficient Algorithms for Linear Suffix Array Construction"
@@ -14,6 +21,9 @@
 
 
 #include "csais.h"
+extern "C" {
+#include "xerrors.h"
+}
 
 using namespace std;
 using namespace sdsl;
@@ -24,54 +34,179 @@ using namespace sdsl;
   const uint_s EMPTY=0xffffffff; 
 #endif
 
+// number of SA entries prefetched by each thread in the induce stages
+#define INDUCE_BLOCK (1<<16)
+
 // get the character
 #define chr(i) (cs==sizeof(uint_s)?((uint_s *)s)[i]:((uint_p *)s)[i])
 
+// sequence boundaries of the input of cSAIS
+struct seq_bounds {
+  sd_vector<>& b_s;
+  sd_vector<>::rank_1_type r_s; sd_vector<>::select_1_type s_s;
+  bool dense;
+  bit_vector bv; bit_vector::rank_1_type r_bv; // dense copy of b_s
+  vector<uint_s> starts;                       // starting positions of the sequences
+
+  seq_bounds(sd_vector<>& b_s_, bool dense_): b_s(b_s_), dense(dense_) {
+    r_s = sd_vector<>::rank_1_type(&b_s);
+    s_s = sd_vector<>::select_1_type(&b_s);
+    if(dense) {
+      size_t ns = r_s(b_s.size());
+      starts.resize(ns);
+      bv = bit_vector(b_s.size(), 0);
+      for(size_t k=0; k<ns; k++) { starts[k] = s_s(k+1); bv[starts[k]] = 1; }
+      r_bv = bit_vector::rank_1_type(&bv);
+    }
+  }
+  seq_bounds(const seq_bounds&) = delete;
+
+  // true if a sequence starts in position j
+  inline bool is_start(size_t j) { return dense ? bv[j] : b_s[j]==1; }
+  // number of sequences starting before position j
+  inline size_t rank(size_t j) { return dense ? r_bv(j) : r_s(j); }
+  // starting position of the k-th sequence, k starts from 1
+  inline size_t select(size_t k) { return dense ? starts[k-1] : s_s(k); }
+};
+
+// struct shared via count_chars
+typedef struct {
+  uint_s *s; size_t cs;  // input string
+  size_t start, end;     // range of s counted by the thread
+  vector<uint_s> cnt;    // number of occurrences of each character
+} count_data;
+
+// count the characters of s[start..end-1]
+void *count_chars(void *dx) {
+  count_data *d = (count_data *) dx;
+  uint_s *s = d->s; size_t cs = d->cs;
+  for(size_t i=d->start; i<d->end; i++) d->cnt[chr(i)]++;
+  return NULL;
+}
+
 // compute the head or end of each bucket
-void getBuckets(uint_s *s, uint_s *bkt, size_t n, size_t K, size_t cs, bool end) { 
+void getBuckets(uint_s *s, uint_s *bkt, size_t n, size_t K, size_t cs, bool end, int th) { 
   size_t i, sum=0;
   for(i=0; i<K; i++) bkt[i]=0; // clear all buckets
-  for(i=0; i<n; i++) bkt[chr(i)]++; // compute the size of each bucket
+  // the threads use th counters of size K, only if it is small compared to n
+  if(th>1 && (size_t)th*K*8 <= n) {
+    pthread_t t[th];
+    vector<count_data> td(th);
+    for(int k=0; k<th; k++) {
+      td[k].s = s; td[k].cs = cs;
+      td[k].start = n/th*k; td[k].end = (k==th-1) ? n : n/th*(k+1);
+      td[k].cnt.assign(K,0);
+      xpthread_create(&t[k],NULL,&count_chars,&td[k],__LINE__,__FILE__);
+    }
+    for(int k=0; k<th; k++) {
+      xpthread_join(t[k],NULL,__LINE__,__FILE__);
+      for(i=0; i<K; i++) bkt[i]+=td[k].cnt[i];
+    }
+  }
+  else{
+    for(i=0; i<n; i++) bkt[chr(i)]++; // compute the size of each bucket
+  }
   for(i=0; i<K; i++) { sum+=bkt[i]; bkt[i]= end ? sum-1 : sum-bkt[i]; }
 }
 
+// suffix induced by the suffix j in the L (or S) stage, EMPTY if none
+static inline uint_s induced(uint_s *s, size_t cs, uint_s j, seq_bounds& bd, bool L) {
+  // the suffix preceding j in its circular sequence
+  uint_s m = bd.is_start(j) ? bd.select(bd.rank(j+1)+1)-1 : j-1;
+  if(L ? chr(m) >= chr(j) : chr(m) <= chr(j)) return m;
+  return EMPTY;
+}
+
+// block of SA scanned by the induce stages, with the suffixes induced by its entries
+// computed in parallel before the block is scanned
+struct induce_block {
+  uint_s *SA, *s; size_t cs;
+  seq_bounds& bd;
+  bool L; int th;
+  size_t start = 0, size;   // first position and length of the block
+  vector<uint_s> val, ind;  // entries of the block when prefetched, and the suffixes they induce
+
+  induce_block(uint_s *SA_, uint_s *s_, size_t cs_, seq_bounds& bd_, bool L_, int th_):
+    SA(SA_), s(s_), cs(cs_), bd(bd_), L(L_), th(th_) {
+    size = (size_t)th*INDUCE_BLOCK;
+    if(th>1) { val.resize(size); ind.resize(size); }
+  }
+
+  // suffix induced by the entry j in position i of SA
+  inline uint_s get(size_t i, uint_s j) {
+    // the entry may have been written after the block was prefetched
+    if(th>1 && val[i-start]==j) return ind[i-start];
+    return induced(s, cs, j, bd, L);
+  }
+
+  // prefetch the block SA[b..e-1]
+  void fill(size_t b, size_t e);
+};
+
+// struct shared via prefetch_block
+typedef struct {
+  induce_block *blk;
+  size_t start, end;  // range of SA prefetched by the thread
+} prefetch_data;
+
+// compute the suffixes induced by the entries of SA[start..end-1]
+void *prefetch_block(void *dx) {
+  prefetch_data *d = (prefetch_data *) dx;
+  induce_block *b = d->blk;
+  for(size_t i=d->start; i<d->end; i++) {
+    uint_s j = b->SA[i];
+    b->val[i-b->start] = j;
+    if(j!=EMPTY) b->ind[i-b->start] = induced(b->s, b->cs, j, b->bd, b->L);
+  }
+  return NULL;
+}
+
+void induce_block::fill(size_t b, size_t e) {
+  start = b;
+  pthread_t t[th];
+  prefetch_data td[th];
+  size_t len = (e-b+th-1)/th;
+  for(int k=0; k<th; k++) {
+    td[k].blk = this;
+    td[k].start = min(e, b+len*k); td[k].end = min(e, b+len*(k+1));
+    xpthread_create(&t[k],NULL,&prefetch_block,&td[k],__LINE__,__FILE__);
+  }
+  for(int k=0; k<th; k++)
+    xpthread_join(t[k],NULL,__LINE__,__FILE__);
+}
+
 // induce L suffixes for SAIS
-void induceL(uint_s *SA, uint_s *s, uint_s *bkt, sd_vector<>::rank_1_type& r_s, 
-             sd_vector<>::select_1_type& s_s, sd_vector<>& b_s, size_t n, size_t K, 
-             size_t cs, bool phase, int level) { 
+void induceL(uint_s *SA, uint_s *s, uint_s *bkt, seq_bounds& bd, size_t n, size_t K, 
+             size_t cs, bool phase, int level, int th) { 
     
-    size_t i, j, m, rank;
-    getBuckets(s, bkt, n, K, cs, false); // find heads of buckets
+    size_t i, j, m;
+    getBuckets(s, bkt, n, K, cs, false, th); // find heads of buckets
+    induce_block blk(SA, s, cs, bd, true, th);
 
     for(i=0; i<n; ++i){
+        if(th>1 && i%blk.size==0){ blk.fill(i, min(n, i+blk.size)); }
         if(SA[i]!=EMPTY) {
             j=SA[i];
-            if(b_s[j]==1){
-                rank=r_s(j+1);m=s_s(rank+1)-1;
-                if(chr(m) >= chr(j)){ SA[bkt[chr(m)]++]=m; if(phase){ SA[i] = EMPTY; } }
-            }else{
-                if(chr(j-1) >= chr(j)){ SA[bkt[chr(j-1)]++]=j-1; if(phase){ SA[i] = EMPTY; } } 
-            }
+            m=blk.get(i, j);
+            if(m!=EMPTY){ SA[bkt[chr(m)]++]=m; if(phase){ SA[i] = EMPTY; } }
         }
     }
 }
 
 // induce S suffixes for SAIS
-void induceS(uint_s *SA, uint_s *s, uint_s *bkt, vector<uint_s>& singletons, sd_vector<>::rank_1_type& r_s,
-             sd_vector<>::select_1_type& s_s, sd_vector<>& b_s, size_t n, size_t K, size_t cs, bool phase, int level) { 
+void induceS(uint_s *SA, uint_s *s, uint_s *bkt, vector<uint_s>& singletons, seq_bounds& bd,
+             size_t n, size_t K, size_t cs, bool phase, int level, int th) { 
     
-    size_t i, j, m, rank;
-    getBuckets(s, bkt, n, K, cs, true); // find ends of buckets
+    size_t i, j, m;
+    getBuckets(s, bkt, n, K, cs, true, th); // find ends of buckets
+    induce_block blk(SA, s, cs, bd, false, th);
     for(i=0; i<n; ++i){
         size_t ni = n-i-1;
+        if(th>1 && i%blk.size==0){ blk.fill(ni+1 > blk.size ? ni+1-blk.size : 0, ni+1); }
         if(SA[ni]!=EMPTY) {
             j=SA[ni];
-            if(b_s[j]==1){
-                rank=r_s(j+1);m=s_s(rank+1)-1;
-                if(chr(m) <= chr(j) && bkt[chr(m)]<ni){ SA[bkt[chr(m)]--]=m; if(phase){ SA[ni] = EMPTY; } }    
-             }else{
-                if(chr(j-1) <= chr(j) && bkt[chr(j-1)]<ni){ SA[bkt[chr(j-1)]--]=j-1; if(phase){ SA[ni] = EMPTY; } } 
-            }  
+            m=blk.get(ni, j);
+            if(m!=EMPTY && bkt[chr(m)]<ni){ SA[bkt[chr(m)]--]=m; if(phase){ SA[ni] = EMPTY; } }
         }   
     }
   // insert singletons
@@ -114,30 +249,31 @@ uint_s LMSlength(uint_s *s, uint_s sb, uint_s eb, int level, uint_s x, size_t cs
  *  @param cs    integer size
  *  @param level recursion level, debug only
  *  @param b_s   starting positions bit vector
+ *  @param th    number of threads
+ *  @param dense use a dense representation of b_s during the sorting
  *  @return      None
  */
-void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_vector<> &b_s) {
+void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_vector<> &b_s, int th, bool dense) {
   size_t i, j, m, nseq, rank;
   size_t sb, eb, fl, len; 
   // initialize support for rank and select 
-  sd_vector<>::rank_1_type r_s = sd_vector<>::rank_1_type(&b_s);
-  sd_vector<>::select_1_type s_s = sd_vector<>::select_1_type(&b_s);
+  seq_bounds bd(b_s, dense);
   // singletons vector
   vector<uint_s> sn;
   // no. sequences
-  nseq = r_s(n);
+  nseq = bd.rank(n);
   // stage 1: reduce the problem by at least 1/2
   uint_s *bkt = (uint_s *)malloc(sizeof(uint_s)*K); // bucket counters
   
   for(i=0; i<n; i++) SA[i]=EMPTY; // initialize SA values to -1
-  getBuckets(s, bkt, n, K, cs, true); // find ends of buckets
+  getBuckets(s, bkt, n, K, cs, true, th); // find ends of buckets
   
   //initialize onset vector
   vector<uint_s> onset; size_t st = 0;
   onset.reserve(nseq+1); onset.push_back(st);
   // place S* suffixes in their buckets
   for(i=0; i<nseq; ++i){
-      sb = s_s(i+1), eb = s_s(i+2)-1, fl = eb+1, len=eb-sb+1;
+      sb = bd.select(i+1), eb = bd.select(i+2)-1, fl = eb+1, len=eb-sb+1;
       assert(len > 0);
       bool type;
       if(len > 1){
@@ -171,8 +307,8 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
   }
   
   // Induce L ans S suffixes to sort the LMS substrings
-  induceL(SA, s, bkt, r_s, s_s, b_s, n, K, cs, true, level);
-  induceS(SA, s, bkt, sn, r_s, s_s, b_s, n, K, cs, true, level); 
+  induceL(SA, s, bkt, bd, n, K, cs, true, level, th);
+  induceS(SA, s, bkt, sn, bd, n, K, cs, true, level, th); 
   
   free(bkt); // free bucket vector
   
@@ -199,13 +335,13 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
     // insert the first LMS substring
     uint_s pos = SA[0];
     names[pos]=name-1;
-    size_t rank = r_s(pos+1), sb = s_s(rank), eb = s_s(rank+1)-1;
+    size_t rank = bd.rank(pos+1), sb = bd.select(rank), eb = bd.select(rank+1)-1;
     uint_s pre_len = LMSlength(s, sb, eb, level, pos, cs); 
     uint_s prev = pos;  size_t pre_sb = sb, pre_eb = eb;
     // for all S* suffixes
     for(i=1; i<n1; ++i) {
           pos=SA[i]; bool diff=false;
-          rank = r_s(pos+1); sb = s_s(rank); eb = s_s(rank+1)-1;
+          rank = bd.rank(pos+1); sb = bd.select(rank); eb = bd.select(rank+1)-1;
           uint_s len = LMSlength(s, sb, eb, level, pos, cs); 
           // if the LMS length are different skip and increase name counter
           if(len != pre_len){ diff = true; }
@@ -237,7 +373,7 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
   // stage 2: solve the reduced problem
   // recurse if names are not unique yet
   if(name<n1) {
-      cSAIS((uint_s*)s1, SA1, n1, name, sizeof(uint_s), level+1, nb_s);
+      cSAIS((uint_s*)s1, SA1, n1, name, sizeof(uint_s), level+1, nb_s, th, dense);
   } else { // stop the recursion, generate the suffix array of s1 directly
       for(i=0; i<n1; i++){ SA1[s1[i]] = i; }
   }
@@ -249,7 +385,7 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
   j=n1-1;
   for(i=0; i<nseq; ++i){
       size_t ni = nseq-i; bool type;
-      sb=s_s(ni); eb=s_s(ni+1)-1; len=eb-sb+1;
+      sb=bd.select(ni); eb=bd.select(ni+1)-1; len=eb-sb+1;
       if(len==1){ sn.push_back(sb); } // fill singletons vector 
       else{
           // if it is not a singleton find type of the first int
@@ -284,7 +420,7 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
    
   if(n1>0){ // if at least one s* is not a singleton
       for(i=n1; i<n; ++i) SA[i]=EMPTY; // init SA[n1..n-1]
-      getBuckets(s, bkt, n, K, cs, true); // find ends of buckets
+      getBuckets(s, bkt, n, K, cs, true, th); // find ends of buckets
   }
   
   // insert S* suffixes at the end of the buckets
@@ -294,8 +430,8 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
   }
   
   // induce the L and S suffixes to compute the final SA of each level
-  induceL(SA, s, bkt, r_s, s_s, b_s, n, K, cs, false, level);
-  induceS(SA, s, bkt, sn, r_s, s_s, b_s, n, K, cs, false, level); 
+  induceL(SA, s, bkt, bd, n, K, cs, false, level, th);
+  induceS(SA, s, bkt, sn, bd, n, K, cs, false, level, th); 
   
   // free onset and bucket vectors
   onset.clear();
@@ -310,8 +446,11 @@ void cSAIS(uint_s *s, uint_s *SA, size_t n, size_t K, size_t cs, int level, sd_v
  * @param n length of the input string
  * @param K alphabet size
  * @param b_s bitvector of the starting phrases of the parse
+ * @param th number of threads
+ * @param dense use a dense representation of b_s during the sorting
  */
-void csais_int(uint_p *s, uint_s *SA, size_t n, size_t K, sd_vector<> &b_s){
+void csais_int(uint_p *s, uint_s *SA, size_t n, size_t K, sd_vector<> &b_s, int th, bool dense){
     if((s == nullptr) || (SA == nullptr) || (n < 0)) {cerr << "Empty input given." << endl; exit(1);}
-    cSAIS((uint_s *)s, (uint_s *)SA, n, K, sizeof(uint_p), 0, b_s);
+    if(th < 1) th = 1;
+    cSAIS((uint_s *)s, (uint_s *)SA, n, K, sizeof(uint_p), 0, b_s, th, dense);
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
  * from https://github.com/felipelouza/gsa-is/blob/master/gsacak.c which is an implementation
  * of the GSACA-K algorithm.
  *
- * csais_int(s, SA, n, K, b_s) // computes circular SA of an integer vector using cSSAIS. 
+ * csais_int(s, SA, n, K, b_s, th, dense) // computes circular SA of an integer vector using cSSAIS with th threads. 
  *
  */
 // This is the sample code for the SA-IS algorithm presented in
@@ -55,8 +55,10 @@ typedef uint32_t uint_p;
  * @param n length of the input string
  * @param K alphabet size
  * @param b_s bitvector of the starting phrases of the parse
+ * @param th number of threads
+ * @param dense query a plain bitvector copy of b_s during the sorting (n bits more, faster)
  */
-void csais_int(uint_p *s, uint_s *SA, size_t n, size_t K, sdsl::sd_vector<> &b_s);
+void csais_int(uint_p *s, uint_s *SA, size_t n, size_t K, sdsl::sd_vector<> &b_s, int th = 1, bool dense = true);
 
 #endif /* CSAIS_H */
 
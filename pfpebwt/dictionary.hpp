@@ -2,15 +2,50 @@
  * Code to build the SA and LCP arrays of the dictionary of a prefix-free parse.
  * 
  * This code is adapted from https://github.com/maxrossi91/pfp-thresholds/blob/master/include/pfp/dictionary.hpp
+ *
+ * With more than one thread the SA and the LCP are computed by sorting the suffixes
+ * of the phrases, which end at the first EndOfWord: the suffixes are distributed in
+ * buckets by their first two characters, the large buckets are split by one more
+ * character at a time and the small ones are sorted with multikey quicksort. Equal
+ * suffixes are sorted by position as in gsacak, so that saD and lcpD are identical.
+ * Since the time of the sort grows with the length of the common prefixes, once it
+ * compares more than DICT_WORK characters per suffix the ranges still to sort are
+ * sorted by prefix doubling instead: the rank of a suffix is the first entry of its
+ * range in saD, and each round radix sorts a range sharing l characters by the ranks of
+ * the suffixes l characters later: the ones with equal ranks share l+l' characters,
+ * where l' is the length shared by the range of the rank, so that the smallest
+ * shared length at least doubles at each round.
+ * The final ranks are the inverse of saD, and the LCP is then computed with the
+ * algorithm of Kasai et al. on a range of positions per thread.
+ *
+ * In compact mode the LCP is stored with one byte per entry, capped at LCP_CAP, and
+ * the larger values are resolved from d by lcp_at_least only when they are needed.
+ * The SA is then computed without the LCP, that is computed by comparing the adjacent
+ * suffixes up to LCP_CAP characters (5 instead of 9 bytes per character with the
+ * 32 bit integers, 9 instead of 17 with the 64 bit ones).
  */
 
 #ifndef DICTIONARY_HPP
 #define DICTIONARY_HPP
 
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
 extern "C" {
     #include "gsa/gsacak.h"
+    #include "xerrors.h"
 }
 
+// number of buckets of the first two characters of the suffixes
+#define DICT_BUCKETS (1<<16)
+// ranges of at most this many suffixes are sorted with multikey quicksort
+#define DICT_SMALL (1<<14)
+// characters compared per suffix by the parallel sort before switching to prefix doubling
+#define DICT_WORK 32
+// largest value of the compact LCP
+#define LCP_CAP 255
+
 // TODO: Extend it to integer alphabets
 class dictionary{
 private:
@@ -20,22 +55,50 @@ public:
   std::vector<uint8_t> d;
   std::vector<uint32_t> occ; // Algo limit, a word cannot occurs more than 2^32 times
   std::vector<uint_t> saD;
-  std::vector<int_t> lcpD; // Int because of gsacak interface
+  std::vector<int_t> lcpD; // Int because of gsacak interface, empty in compact mode
+  std::vector<uint8_t> lcpC; // LCP capped at LCP_CAP, in compact mode
+  std::vector<uint_t> rnk; // ranks of the suffixes (inverse of saD at the end) of prefix doubling, empty otherwise
   sdsl::bit_vector b_d; // Starting position of each phrase in D  
   sdsl::bit_vector b_s;
   sdsl::bit_vector::rank_1_type rank_b_d;
   sdsl::bit_vector::select_1_type select_b_d;
   sdsl::bit_vector::rank_1_type rank_b_s;
+  int th = 1; // number of threads for the SA and the LCP
+  bool compact = false; // store the compact LCP
 
   // default constructor for load.
   dictionary() {}
 
   dictionary(std::string filename,
-             size_t w)
+             size_t w, int th_ = 1, bool compact_ = false): th(th_), compact(compact_)
   {
     // Building dictionary from file
     std::string tmp_filename = filename + std::string(".edict");
     read_file(tmp_filename.c_str(), d);
+    // reading occurrences file
+    tmp_filename = filename + std::string(".eocc");
+    read_file(tmp_filename.c_str(), occ);
+    
+    tmp_filename = filename + std::string(".fchar");
+    read_file(tmp_filename.c_str(), fchar);
+
+    init();
+    }
+
+  /*
+   * constructor from the content of the .edict, .eocc and .fchar files
+   * kept in memory (er-build), the vectors are moved
+   */
+  dictionary(std::vector<uint8_t> &d_, std::vector<uint32_t> &occ_, std::vector<uint32_t> &fchar_, size_t w, int th_ = 1, bool compact_ = false): th(th_), compact(compact_)
+  {
+    d.swap(d_);
+    occ.swap(occ_);
+    fchar.swap(fchar_);
+    init();
+  }
+
+    // build the bit vectors, the SA and the LCP of the dictionary
+    void init(){
     // Creating bit vector for concatenated dictionary
     b_d = sdsl::bit_vector(d.size(),0);
     b_d[0] = 1;
@@ -46,13 +109,6 @@ public:
 
     rank_b_d = sdsl::bit_vector::rank_1_type(&b_d);
     select_b_d = sdsl::bit_vector::select_1_type(&b_d);
-    // reading occurrences file
-
-    tmp_filename = filename + std::string(".eocc");
-    read_file(tmp_filename.c_str(), occ);
-    
-    tmp_filename = filename + std::string(".fchar");
-    read_file(tmp_filename.c_str(), fchar);
     
     b_s = sdsl::bit_vector(d.size(),0);
     for(size_t i=0;i<fchar.size();i+=2){
@@ -72,12 +128,411 @@ public:
         // of the concatenated dictionary
         // resize SA and LCP arrays of the dictionary
         saD.resize(d.size());
-        lcpD.resize(d.size());
+        if(compact){ lcpC.resize(d.size()); }
+        else{ lcpD.resize(d.size()); }
         verbose("Computing SA and LCP of the dictionary");
         _elapsed_time(
-            gsacak(&d[0], &saD[0], &lcpD[0], nullptr, d.size());       
+            if(th > 1){ build_parallel(); }
+            else if(compact){ gsacak(&d[0], &saD[0], nullptr, nullptr, d.size()); }
+            else{ gsacak(&d[0], &saD[0], &lcpD[0], nullptr, d.size()); }
+            if(compact){ build_compact_lcp(); }
         );
     }
+
+    // true if the LCP of the suffixes saD[i-1] and saD[i] is at least l
+    inline bool lcp_at_least(size_t i, size_t l) const
+    {
+        if(!compact){ return (size_t)lcpD[i] >= l; }
+        if(lcpC[i] < LCP_CAP or l <= LCP_CAP){ return lcpC[i] >= l; }
+        // the LCP is at least LCP_CAP, compare the following characters
+        return lcp(saD[i-1], saD[i], l, LCP_CAP) >= l;
+    }
+
+private:
+    // range [b,e) of saD whose suffixes share the first l characters
+    struct sort_task{ size_t b, e, l; };
+
+    // data of a thread of the parallel construction
+    struct build_task{
+        dictionary *dict;
+        std::vector<sort_task> *in, out;
+        std::atomic<size_t> *next;
+        // characters compared by all the threads, and their limit
+        std::atomic<size_t> *work;
+        size_t budget;
+        // prefix doubling: ranges of in sorted by the thread and their new ranks
+        std::vector<size_t> done;
+        std::vector<uint_t> ranks;
+        // range of positions and bucket counts of the thread
+        size_t b, e;
+        std::vector<size_t> cnt;
+    };
+
+    // the suffixes end at EndOfWord or EndOfDict, that are never matched
+    static inline bool ended(uint8_t c){ return c <= EndOfWord; }
+
+    // bucket of the suffix i: its first character, and the second one if the first is not a separator
+    inline size_t bucket(size_t i) const { return ended(d[i]) ? (size_t)d[i] << 8 : ((size_t)d[i] << 8) | d[i+1]; }
+
+    // true if the suffix i is smaller than the suffix j, given that they share the first l characters
+    inline bool less(size_t i, size_t j, size_t l, size_t &work) const
+    {
+        size_t l0 = l;
+        while(d[i+l] == d[j+l] and !ended(d[i+l])){ ++l; }
+        work += l-l0+1;
+        return d[i+l] == d[j+l] ? i < j : d[i+l] < d[j+l];
+    }
+
+    // sort by position the suffixes in [b,e), that are equal
+    void sort_equal(size_t b, size_t e){ std::sort(saD.begin()+b, saD.begin()+e); }
+
+    // multikey quicksort of the suffixes in [b,e), that share the first l characters,
+    // the number of compared characters is added to work
+    void mkqs(size_t b, size_t e, size_t l, size_t &work)
+    {
+        while(e-b > 1){
+            if(e-b <= 16){
+                for(size_t i=b+1; i<e; ++i){
+                    uint_t x = saD[i]; size_t j = i;
+                    for(; j>b and less(x, saD[j-1], l, work); --j){ saD[j] = saD[j-1]; }
+                    saD[j] = x;
+                }
+                return;
+            }
+            // median of three pivot
+            uint8_t a = d[saD[b]+l], m = d[saD[b+(e-b)/2]+l], z = d[saD[e-1]+l];
+            uint8_t v = (a < m) ? ((m < z) ? m : ((a < z) ? z : a)) : ((a < z) ? a : ((m < z) ? z : m));
+            // [b,lt) < v, [lt,gt) == v, [gt,e) > v
+            size_t lt = b, gt = e, i = b;
+            work += e-b;
+            while(i < gt){
+                uint8_t c = d[saD[i]+l];
+                if(c < v){ std::swap(saD[lt++], saD[i++]); }
+                else if(c > v){ std::swap(saD[i], saD[--gt]); }
+                else{ ++i; }
+            }
+            mkqs(b, lt, l, work);
+            mkqs(gt, e, l, work);
+            if(ended(v)){ sort_equal(lt, gt); return; }
+            b = lt; e = gt; ++l;
+        }
+    }
+
+    // split the suffixes in [b,e) by their character l (in place), and append the ranges to sort to out
+    void split(size_t b, size_t e, size_t l, std::vector<sort_task> &out)
+    {
+        size_t cnt[256] = {0}, start[257], pos[256];
+        // the characters are read once from d
+        std::vector<uint8_t> key(e-b);
+        for(size_t i=b; i<e; ++i){ key[i-b] = d[saD[i]+l]; cnt[key[i-b]]++; }
+        start[0] = b;
+        for(size_t c=0; c<256; ++c){ start[c+1] = start[c] + cnt[c]; pos[c] = start[c]; }
+        // american flag sort
+        for(size_t c=0; c<256; ++c){
+            while(pos[c] < start[c+1]){
+                uint_t x = saD[pos[c]];
+                uint8_t y = key[pos[c]-b];
+                while(y != c){
+                    size_t j = pos[y]++;
+                    std::swap(x, saD[j]);
+                    std::swap(y, key[j-b]);
+                }
+                saD[pos[c]] = x; key[pos[c]-b] = y;
+                pos[c]++;
+            }
+        }
+        for(size_t c=0; c<256; ++c){
+            if(cnt[c] < 2) continue;
+            if(ended(c)){ sort_equal(start[c], start[c+1]); }
+            else{ out.push_back({start[c], start[c+1], l+1}); }
+        }
+    }
+
+    // count the buckets of the positions [b,e)
+    static void *count_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        t->cnt.assign(DICT_BUCKETS, 0);
+        for(size_t i=t->b; i<t->e; ++i){ t->cnt[t->dict->bucket(i)]++; }
+        return NULL;
+    }
+
+    // write the positions [b,e) in their buckets, cnt are the first free entries
+    static void *scatter_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        for(size_t i=t->b; i<t->e; ++i){ t->dict->saD[t->cnt[t->dict->bucket(i)]++] = i; }
+        return NULL;
+    }
+
+    // sort the tasks taken from in, the large ones are split and the new tasks added to out,
+    // until the work exceeds the budget
+    static void *sort_task_run(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        size_t k;
+        while(*t->work <= t->budget and (k = (*t->next)++) < t->in->size()){
+            sort_task &s = (*t->in)[k];
+            size_t w = s.e - s.b;
+            if(s.e - s.b > DICT_SMALL){ t->dict->split(s.b, s.e, s.l, t->out); }
+            else{ t->dict->mkqs(s.b, s.e, s.l, w); }
+            *t->work += w;
+        }
+        return NULL;
+    }
+
+    // set the ranks of the suffixes of the entries of the thread: the first entry of
+    // their range of in (sorted), otherwise their own entry
+    static void *rank_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        std::vector<sort_task> &in = *t->in;
+        // first range ending after b, the ranges are sorted and disjoint
+        size_t k = std::upper_bound(in.begin(), in.end(), t->b,
+                                    [](size_t b, const sort_task &a){ return b < a.e; }) - in.begin();
+        for(size_t j=t->b; j<t->e; ++j){
+            while(k < in.size() and in[k].e <= j){ k++; }
+            D.rnk[D.saD[j]] = (k < in.size() and in[k].b <= j) ? in[k].b : j;
+        }
+        return NULL;
+    }
+
+    // set the ranks computed by double_task, after all the threads have read the old ones
+    static void *update_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        size_t c = 0;
+        for(size_t k : t->done){
+            sort_task &s = (*t->in)[k];
+            for(size_t j=s.b; j<s.e; ++j){ D.rnk[D.saD[j]] = t->ranks[c++]; }
+        }
+        return NULL;
+    }
+
+    // sort key by the ranks (first), radix sorting the large arrays by 11 bits at a time
+    static void sort_ranks(std::vector<std::pair<uint_t,uint_t>> &key, std::vector<std::pair<uint_t,uint_t>> &tmp)
+    {
+        typedef std::pair<uint_t,uint_t> item;
+        if(key.size() < 256){
+            std::sort(key.begin(), key.end(), [](const item &a, const item &b){ return a.first < b.first; });
+            return;
+        }
+        uint_t lo = key[0].first, hi = key[0].first;
+        for(const item &x : key){ if(x.first < lo){ lo = x.first; } if(x.first > hi){ hi = x.first; } }
+        tmp.resize(key.size());
+        std::vector<size_t> cnt(1 << 11);
+        for(size_t shift=0; shift < 64 and ((uint64_t)(hi - lo) >> shift) > 0; shift += 11){
+            std::fill(cnt.begin(), cnt.end(), 0);
+            for(const item &x : key){ cnt[((uint64_t)(x.first - lo) >> shift) & 2047]++; }
+            for(size_t c=0, sum=0; c < cnt.size(); ++c){ size_t v = cnt[c]; cnt[c] = sum; sum += v; }
+            for(const item &x : key){ tmp[cnt[((uint64_t)(x.first - lo) >> shift) & 2047]++] = x; }
+            key.swap(tmp);
+        }
+    }
+
+    // sort the suffixes of the ranges taken from in (sorted) by the rank of the suffix l
+    // characters later. The suffixes with equal ranks are in the same range of in, that
+    // shares l' characters, and they are added to out as a range sharing l+l' characters
+    static void *double_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        std::vector<std::pair<uint_t,uint_t>> key, tmp;
+        size_t k;
+        while((k = (*t->next)++) < t->in->size()){
+            sort_task &s = (*t->in)[k];
+            // the suffixes do not end in the first l characters, so saD[j]+l < n
+            key.resize(s.e - s.b);
+            for(size_t j=s.b; j<s.e; ++j){ key[j-s.b] = {D.rnk[D.saD[j]+s.l], D.saD[j]}; }
+            sort_ranks(key, tmp);
+            t->done.push_back(k);
+            for(size_t j=s.b, f=s.b; j<s.e; ++j){
+                D.saD[j] = key[j-s.b].second;
+                if(j+1 == s.e or key[j+1-s.b].first != key[j-s.b].first){
+                    // new ranks: the first entry of the range, or j for a single suffix
+                    t->ranks.insert(t->ranks.end(), j+1-f, j > f ? f : j);
+                    if(j > f){
+                        // range of the rank, the single suffixes have distinct ranks
+                        uint_t r = key[j-s.b].first;
+                        auto g = std::lower_bound(t->in->begin(), t->in->end(), r,
+                                                  [](const sort_task &a, uint_t b){ return a.b < b; });
+                        assert(g != t->in->end() and g->b == r);
+                        t->out.push_back({f, j+1, s.l + g->l});
+                    }
+                    f = j+1;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    // run f on th threads over the ranges of in, the ranges added by the threads are returned
+    std::vector<sort_task> run_ranges(std::vector<build_task> &t, void *(*f)(void *), std::vector<sort_task> &in)
+    {
+        std::atomic<size_t> next(0);
+        for(size_t k=0; k<t.size(); ++k){
+            t[k].in = &in; t[k].next = &next; t[k].out.clear();
+            t[k].done.clear(); t[k].ranks.clear();
+        }
+        run(t, f, 0);
+        std::vector<sort_task> out;
+        for(size_t k=0; k<t.size(); ++k){ out.insert(out.end(), t[k].out.begin(), t[k].out.end()); }
+        return out;
+    }
+
+    // sort the ranges of tasks by prefix doubling, the other suffixes are in their final entry.
+    // The separators are unique characters ordered by position, as the ties in gsacak
+    void prefix_doubling(std::vector<build_task> &t, std::vector<sort_task> &tasks)
+    {
+        size_t n = d.size();
+        rnk.resize(n);
+        // the ranks are updated after each round, so that the ranges of the ranks are
+        // the ranges of tasks, sorted to find them
+        std::sort(tasks.begin(), tasks.end(), [](const sort_task &a, const sort_task &b){ return a.b < b.b; });
+        for(size_t k=0; k<t.size(); ++k){ t[k].in = &tasks; }
+        run(t, &rank_task, n);
+        size_t rounds = 0;
+        while(!tasks.empty()){
+            std::vector<sort_task> out = run_ranges(t, &double_task, tasks);
+            run(t, &update_task, 0);
+            std::sort(out.begin(), out.end(), [](const sort_task &a, const sort_task &b){ return a.b < b.b; });
+            tasks.swap(out);
+            rounds++;
+        }
+        verbose("Prefix doubling rounds: ", rounds);
+    }
+
+    // LCP of the suffixes x and y, at most cap, given that it is at least l,
+    // comparing 8 characters at a time
+    size_t lcp(size_t x, size_t y, size_t cap, size_t l = 0) const
+    {
+        const uint64_t ones = 0x0101010101010101ULL, high = 0x8080808080808080ULL;
+        size_t n = d.size();
+        while(l < cap and x+l+8 <= n and y+l+8 <= n){
+            uint64_t a, b;
+            memcpy(&a, &d[x+l], 8); memcpy(&b, &d[y+l], 8);
+            // bytes that differ, and bytes of a that end the suffix (smaller than 2)
+            uint64_t diff = a ^ b, end = (a - 2*ones) & ~a & high;
+            if(diff == 0 and end == 0){ l += 8; continue; }
+            size_t j = std::min(diff ? __builtin_ctzll(diff) : 64, end ? __builtin_ctzll(end) : 64) / 8;
+            return std::min(l + j, cap);
+        }
+        while(l < cap and d[x+l] == d[y+l] and !ended(d[x+l])){ ++l; }
+        return std::min(l, cap);
+    }
+
+    // compute the LCP of the suffixes in [b,e)
+    static void *lcp_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        for(size_t i=t->b; i<t->e; ++i){
+            D.lcpD[i] = (i == 0) ? 0 : D.lcp(D.saD[i-1], D.saD[i], SIZE_MAX);
+        }
+        return NULL;
+    }
+
+    // compute the LCP of the suffixes starting in [b,e) from the inverse of saD (rnk), the LCP
+    // of the suffix i+1 is at least the one of the suffix i minus one (Kasai et al.)
+    static void *kasai_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        size_t h = 0;
+        for(size_t i=t->b; i<t->e; ++i){
+            size_t r = D.rnk[i];
+            if(r == 0){ D.lcpD[0] = 0; h = 0; continue; }
+            h = D.lcp(D.saD[r-1], i, SIZE_MAX, h);
+            D.lcpD[r] = h;
+            if(h > 0){ h--; }
+        }
+        return NULL;
+    }
+
+    // compute the compact LCP of the suffixes in [b,e)
+    static void *compact_lcp_task(void *arg)
+    {
+        build_task *t = (build_task *) arg;
+        dictionary &D = *t->dict;
+        for(size_t i=t->b; i<t->e; ++i){
+            D.lcpC[i] = (i == 0) ? 0 : D.lcp(D.saD[i-1], D.saD[i], LCP_CAP);
+        }
+        return NULL;
+    }
+
+    // run f on th threads (at least one), the thread k gets the k-th range of [0,n)
+    void run(std::vector<build_task> &t, void *(*f)(void *), size_t n)
+    {
+        int nt = t.size();
+        pthread_t p[nt];
+        for(int k=0; k<nt; ++k){
+            t[k].dict = this;
+            t[k].b = n/nt*k; t[k].e = (k == nt-1) ? n : n/nt*(k+1);
+            xpthread_create(&p[k],NULL,f,&t[k],__LINE__,__FILE__);
+        }
+        for(int k=0; k<nt; ++k)
+            xpthread_join(p[k],NULL,__LINE__,__FILE__);
+    }
+
+    // compute the compact LCP from saD
+    void build_compact_lcp()
+    {
+        std::vector<build_task> t(th > 1 ? th : 1);
+        run(t, &compact_lcp_task, d.size());
+    }
+
+    // compute saD and lcpD with th threads
+    void build_parallel()
+    {
+        size_t n = d.size();
+        assert(n > 0 and d[n-1] == EndOfDict);
+        std::vector<build_task> t(th);
+        // bucket the suffixes by their first two characters, in order of position
+        run(t, &count_task, n);
+        std::vector<size_t> bkt(DICT_BUCKETS+1, 0);
+        for(size_t c=0; c<DICT_BUCKETS; ++c){
+            bkt[c+1] = bkt[c];
+            for(int k=0; k<th; ++k){
+                size_t x = t[k].cnt[c];
+                t[k].cnt[c] = bkt[c+1];
+                bkt[c+1] += x;
+            }
+        }
+        run(t, &scatter_task, n);
+        // the suffixes of a bucket starting with a separator are equal
+        std::vector<sort_task> tasks;
+        for(size_t c=0; c<DICT_BUCKETS; ++c){
+            if(bkt[c+1] - bkt[c] > 1 and !ended(c >> 8) and !ended(c & 0xff)){
+                tasks.push_back({bkt[c], bkt[c+1], 2});
+            }
+        }
+        // rounds of sorting, until no range is split
+        std::atomic<size_t> work(0);
+        while(!tasks.empty() and work <= n*DICT_WORK){
+            std::atomic<size_t> next(0);
+            for(int k=0; k<th; ++k){
+                t[k].in = &tasks; t[k].next = &next; t[k].out.clear();
+                t[k].work = &work; t[k].budget = n*DICT_WORK;
+            }
+            run(t, &sort_task_run, 0);
+            // the ranges not taken once the work exceeded the budget are still to sort
+            std::vector<sort_task> out(tasks.begin() + std::min<size_t>(next, tasks.size()), tasks.end());
+            for(int k=0; k<th; ++k){ out.insert(out.end(), t[k].out.begin(), t[k].out.end()); }
+            tasks.swap(out);
+        }
+        verbose("Characters compared per suffix: ", (double)work/n);
+        if(!tasks.empty()){
+            // long common prefixes, the sorted ranges are kept
+            verbose("Too many characters compared, sorting the remaining ranges by prefix doubling");
+            prefix_doubling(t, tasks);
+        }
+        // the compact LCP is computed by build, the long LCPs of the suffixes sorted
+        // by prefix doubling are computed with the ranks
+        if(!compact){ run(t, rnk.empty() ? &lcp_task : &kasai_task, n); }
+        std::vector<uint_t>().swap(rnk);
+    }
 };
   
 
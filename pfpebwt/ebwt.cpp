@@ -37,6 +37,9 @@ typedef struct {
    bool rle = 0;
    bool sample_first = 0;
    bool sample = 0;
+   int th = 1; // number of threads for the SA of the dictionary, the eBWT and the gCA samples
+   bool compact = 0; // compact LCP of the dictionary
+   size_t sa_rate = 0; // sample rate of the gCA values written to .gsam (0 = no samples)
 } Args;
 
 
@@ -50,16 +53,22 @@ static void parseArgs(int argc, char** argv, Args *arg ) {
     printf(" %s",argv[i]); 
   puts("\n");
 
-  while ((c = getopt( argc, argv, "w:rsf") ) != -1) { 
+  while ((c = getopt( argc, argv, "w:t:rsfcg:") ) != -1) { 
     switch(c) { 
       case 'w':
       arg->w = atoi(optarg); break; 
+      case 't':
+      arg->th = atoi(optarg); break;
       case 'r':
       arg->rle = 1; break; 
       case 's':
       arg->sample = true; break;
       case 'f':
       arg->sample_first = true; break;
+      case 'c':
+      arg->compact = true; break;
+      case 'g':
+      arg->sa_rate = atoi(optarg); break;
       case '?':
       puts("Unknown option. Use -h for help.");
       exit(1);
@@ -85,7 +94,7 @@ int main(int argc, char** argv) {
     start_wc = time(NULL);
     
     cout << "Computing BWT of the dictionary..." << endl;
-    dictionary dict(arg.inputFileName,arg.w);
+    dictionary dict(arg.inputFileName,arg.w,arg.th,arg.compact);
     
     cout << "Building the BWT of the dictionary took: " << difftime(time(NULL),start_wc) << " wall clock seconds\n";
     start_wc = time(NULL);
@@ -98,7 +107,7 @@ int main(int argc, char** argv) {
     else{
       // compute the eBWT + gCA samples
       cout << "Computing the eBWT of the text and the GCA-samples..." << endl;
-      pfp_ssa pfp_ssa(pars,dict,arg.inputFileName,arg.w,arg.rle,arg.sample_first);
+      pfp_ssa pfp_ssa(pars,dict,arg.inputFileName,arg.w,arg.rle,arg.sample_first,arg.th,arg.sa_rate);
     }
     
     cout << "Building the eBWT of Text took: " << difftime(time(NULL),start_wc) << " wall clock seconds\n";
@@ -0,0 +1,105 @@
+/*
+ * Loser tree to merge k sorted lists of distinct integers (e.g. the inverted lists
+ * of the phrases of the parse).
+ *
+ * The lists are stored as pointer ranges and the tree stores, for each internal node,
+ * the list that lost the match in that node, so that removing elements from the
+ * winner replays only the matches on its path to the root. The runner-up is one of
+ * the losers on that path, so the elements of the winner smaller than the first
+ * element of any other list (a run) are found with a galloping search and removed
+ * at once.
+ */
+
+#ifndef LOSER_TREE_HPP
+#define LOSER_TREE_HPP
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+template<class T>
+class loser_tree{
+public:
+    loser_tree(){}
+
+    // add the sorted list [b,e)
+    void push(const T *b, const T *e)
+    {
+        cur.push_back(b);
+        end.push_back(e);
+    }
+
+    // build the tree, after adding all the lists
+    void build()
+    {
+        k = cur.size();
+        K = 1;
+        while(K < k){ K *= 2; }
+        // empty lists up to a power of two
+        cur.resize(K, nullptr);
+        end.resize(K, nullptr);
+        // winners of the subtrees
+        std::vector<size_t> win(2*K);
+        for(size_t i=0; i<K; ++i){ win[K+i] = i; }
+        tree.assign(K, 0);
+        for(size_t n=K-1; n>=1; --n){
+            size_t a = win[2*n], b = win[2*n+1];
+            if(key(b) < key(a)){ std::swap(a,b); }
+            win[n] = a; tree[n] = b;
+        }
+        winner = win[1];
+    }
+
+    // true if all the lists are empty
+    bool empty() const { return cur[winner] == end[winner]; }
+
+    // list with the smallest first element
+    size_t top() const { return winner; }
+
+    // first element of list top()
+    const T* head() const { return cur[winner]; }
+
+    // number of elements of list top() smaller than the first element of the other lists
+    size_t run() const
+    {
+        T bound = max_key();
+        for(size_t n=(K+winner)/2; n>=1; n/=2){ bound = std::min(bound, key(tree[n])); }
+        const T *p = cur[winner], *e = end[winner];
+        if(bound == max_key()){ return e-p; }
+        // galloping search of the first element larger than bound
+        size_t step = 1;
+        while(step < size_t(e-p) && p[step] < bound){ step *= 2; }
+        const T *q = std::lower_bound(p + step/2, p + std::min(step, size_t(e-p)), bound);
+        return q-p;
+    }
+
+    // remove the first r elements of list top()
+    void pop(size_t r = 1)
+    {
+        cur[winner] += r;
+        // replay the matches on the path to the root
+        size_t x = winner;
+        for(size_t n=(K+winner)/2; n>=1; n/=2){
+            if(key(tree[n]) < key(x)){ std::swap(tree[n], x); }
+        }
+        winner = x;
+    }
+
+private:
+    // key of the empty lists (parenthesized, gsacak.h defines a max macro)
+    static inline T max_key(){ return (std::numeric_limits<T>::max)(); }
+
+    // first element of list i, max_key if empty
+    inline T key(size_t i) const { return cur[i] == end[i] ? max_key() : *cur[i]; }
+
+    // current position and end of each list
+    std::vector<const T*> cur, end;
+    // number of lists, number of leaves
+    size_t k = 0, K = 1;
+    // loser of each internal node
+    std::vector<size_t> tree;
+    // list with the smallest first element
+    size_t winner = 0;
+};
+
+#endif /* LOSER_TREE_HPP */
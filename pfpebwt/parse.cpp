@@ -23,6 +23,8 @@ using namespace std;
 typedef struct {
    string inputFileName = "";
    int w = 10;
+   int th = 1; // number of threads for the cSA of the parse
+   bool dense = true; // dense sequence boundaries during the cSA
 } Args;
 
 
@@ -36,10 +38,14 @@ static void parseArgs(int argc, char** argv, Args *arg ) {
     printf(" %s",argv[i]);
   puts("\n");
 
-  while ((c = getopt( argc, argv, "w:r") ) != -1) {
+  while ((c = getopt( argc, argv, "w:t:sr") ) != -1) {
     switch(c) {
       case 'w':
       arg->w = atoi(optarg); break;
+      case 't':
+      arg->th = atoi(optarg); break;
+      case 's':
+      arg->dense = false; break;
       case '?':
       puts("Unknown option. Use -h for help.");
       exit(1);
@@ -60,7 +66,7 @@ int main(int argc, char** argv) {
     time_t start_wc = time(NULL);
     
     cout << "Computing eBWT of the parse..." << endl;
-    parse pars(arg.inputFileName);
+    parse pars(arg.inputFileName, true, true, arg.th, arg.dense);
     
     cout << "Building the eBWT of the parse took: " << difftime(time(NULL),start_wc) << " wall clock seconds\n";
 
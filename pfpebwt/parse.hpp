@@ -12,9 +12,9 @@
 
 #include "common.hpp"
 #include "csais.h"
-//extern "C" {
+extern "C" {
 #include "utils.h"
-//}
+}
 // #include "malloc_count.h"
 
 class parse{
@@ -28,6 +28,8 @@ private:
     sdsl::sd_vector<>::select_1_type select_b_d;
     size_t size;
     size_t alphabet_size;
+    int th = 1; // number of threads for the cSA of the parse
+    bool dense = true; // dense sequence boundaries during the cSA of the parse
 
     // extract an integer from a length n array containing IBYTES bytes per element
     uint64_t get_uint(uint8_t *a, long n, long i)
@@ -58,20 +60,16 @@ public:
     
     parse(std::string filename,
           bool saP_flag_ = true,
-          bool ilP_flag_ = true)//:
+          bool ilP_flag_ = true,
+          int th_ = 1,
+          bool dense_ = true)//:
           //alphabet_size(alphabet_size_)
   {
+    th = th_;
+    dense = dense_;
     // read file
     std::string tmp_filename = filename + std::string(".eparse");
     read_file(tmp_filename.c_str(), p);
-    alphabet_size = *std::max_element(p.begin(),p.end());
-    size = p.size();
-  
-    //   std::cout << "Memory peak-eparse: " << malloc_count_peak() << std::endl;
-    #if P64 == 0
-        // if we are in 32 bit mode, check that parse has less than 2^32-2 words
-        checkParseSize();
-    #endif 
 
     std::string outfile = filename + std::string(".slast");
     if((sorted_last = fopen(outfile.c_str(), "w")) == nullptr)
@@ -84,28 +82,10 @@ public:
     tmp_filename = filename + std::string(".last");
     read_file(tmp_filename.c_str(), last);
 
-    // create bit vector for starting positions
-    sts.push_back(size);
-    sdsl::sd_vector_builder builder(size+1,sts.size());
-    for(auto idx: sts){builder.set(idx);}
-    b_d = sdsl::sd_vector<>(builder);
-    build(saP_flag_, ilP_flag_);
-    
-    buildBitIl(); // build Inverted List
-
-    std::vector<uint32_t> temp(offset.size(),0);
+    std::vector<uint32_t> temp;
     tmp_filename = filename + std::string(".offset");
     read_file(tmp_filename.c_str(), temp);
-    
-    // build vector of starting character offsets
-    offset.resize(temp.size()); size_t j=0;
-    for(size_t i=0;i<ilP.size();++i){
-        if(b_st[i]==1){
-            offset[j] = temp[rank_b_d(saP[ilP[i]]+1)-1]; ++j;
-        }
-    }
-    temp.clear();
-    clearVectors();
+    buildIl(temp, saP_flag_, ilP_flag_);
 
     // serialize parse data structures
     std::string output = filename + std::string(".sdsl");
@@ -119,6 +99,53 @@ public:
     out.close();
     
    }
+
+    /*
+     * constructor from the parse, the starting and last positions and the offsets
+     * kept in memory (er-build), the sorted last positions are written to sorted_last_
+     * and the data structures are not serialized
+     */
+    parse(std::vector<uint_p> &p_, std::vector<uint64_t> &sts_, std::vector<uint8_t> &last_,
+          std::vector<uint32_t> &offset_, FILE *sorted_last_, int th_ = 1)
+  {
+    th = th_;
+    p.swap(p_);
+    sts.swap(sts_);
+    last.swap(last_);
+    sorted_last = sorted_last_;
+    buildIl(offset_, true, true);
+  }
+
+    // build the inverted list of the eBWT of the parse p and the vector of starting character offsets
+    void buildIl(std::vector<uint32_t> &temp, bool saP_flag_, bool ilP_flag_){
+        alphabet_size = *std::max_element(p.begin(),p.end());
+        size = p.size();
+
+        //   std::cout << "Memory peak-eparse: " << malloc_count_peak() << std::endl;
+        #if P64 == 0
+            // if we are in 32 bit mode, check that parse has less than 2^32-2 words
+            checkParseSize();
+        #endif 
+
+        // create bit vector for starting positions
+        sts.push_back(size);
+        sdsl::sd_vector_builder builder(size+1,sts.size());
+        for(auto idx: sts){builder.set(idx);}
+        b_d = sdsl::sd_vector<>(builder);
+        build(saP_flag_, ilP_flag_);
+        
+        buildBitIl(); // build Inverted List
+
+        // build vector of starting character offsets
+        offset.resize(temp.size()); size_t j=0;
+        for(size_t i=0;i<ilP.size();++i){
+            if(b_st[i]==1){
+                offset[j] = temp[rank_b_d(saP[ilP[i]]+1)-1]; ++j;
+            }
+        }
+        temp.clear();
+        clearVectors();
+    }
     
     void build(bool saP_flag_, bool ilP_flag_){
         size_t p_size = p.size();
@@ -129,7 +156,7 @@ public:
             _elapsed_time(
                 std::cout << "Starting computing cSA" << std::endl;
                 // build SA using circular SAIS algorithm
-                csais_int(&p[0],&saP[0], size, alphabet_size+1, b_d);
+                csais_int(&p[0],&saP[0], size, alphabet_size+1, b_d, th, dense);
             );
         }
         if(ilP_flag_){
@@ -13,6 +13,8 @@
 #include <tuple>
 #include <queue>
 
+#include "loser_tree.hpp"
+
 class pfp{
 private:
     typedef struct
@@ -188,7 +190,7 @@ public:
 
                 phrase_suffix_t next = curr;
 
-                while (inc(next) && (dict.lcpD[next.i] >= curr.suffix_length))
+                while (inc(next) && dict.lcp_at_least(next.i, curr.suffix_length))
                 {
                     assert(next.suffix_length >= curr.suffix_length);
                     assert((dict.b_d[next.sn] == 0 && next.suffix_length >= w) || (next.suffix_length != curr.suffix_length));
@@ -213,55 +215,32 @@ public:
                 {       
                     //suffix not starting with a character occurring at the beginning of 
                     // a input sequence
+                    // merge the inverted lists of the phrases
+                    loser_tree<uint_s> lt;
+                    for (auto s: same_suffix){
+                        size_t begin = pars.select_ilist(s.phrase);
+                        size_t end = pars.select_ilist(s.phrase+1);
+                        lt.push(&pars.ilP[begin], &pars.ilP[end]);
+                    }
+                    lt.build();
                     if(!st_chars){
-                        typedef std::pair<uint_s *, std::pair<uint_s *, uint8_t>> pq_t;
-                        // using lambda to compare elements.
-                        auto cmp = [](const pq_t &lhs, const pq_t &rhs) {
-                            return *lhs.first > *rhs.first;
-                        };
-                        std::priority_queue<pq_t, std::vector<pq_t>, decltype(cmp)> pq(cmp);
-                        
-                        for (auto s: same_suffix){
-                            size_t begin = pars.select_ilist(s.phrase);
-                            size_t end = pars.select_ilist(s.phrase+1);
-                            pq.push({&pars.ilP[begin], {&pars.ilP[end], s.bwt_char}});
+                        // a run of occurrences of the same phrase is inserted at once
+                        while(!lt.empty()){
+                            size_t r = lt.run();
+                            update_ebwt(same_suffix[lt.top()].bwt_char, r, 0, 0, 0);
+                            lt.pop(r);
                         }
-                        while(!pq.empty()){
-                            auto curr_occ = pq.top();
-                            pq.pop();
-                            update_ebwt(curr_occ.second.second, 1, 0, 0, 0);
-                            
-                            // Update pq
-                            curr_occ.first++;
-                            if (curr_occ.first != curr_occ.second.first)
-                                pq.push(curr_occ);
-                        
-                        }                      
                     }else{
                         //check and store the positions at which the start of string characters
                         //are inserted in the ebwt (we need them to invert the ebwt)
-                        typedef std::pair<uint_s *, std::tuple<uint_s *, uint8_t, size_t, size_t>> tq_t;
-                        
-                        auto cmp2 = [](const tq_t &lhs, const tq_t &rhs) {
-                            return *lhs.first > *rhs.first;
-                        };
-                        std::priority_queue<tq_t, std::vector<tq_t>, decltype(cmp2)> tq(cmp2);
-                        for (auto s: same_suffix){
-                            size_t begin = pars.select_ilist(s.phrase);
-                            size_t end = pars.select_ilist(s.phrase+1);
-                            tq.push({&pars.ilP[begin], std::make_tuple(&pars.ilP[end], s.bwt_char, begin, s.st_pos)});
-                        }
-                        while(!tq.empty()){
-                            auto curr_occ = tq.top();
-                            tq.pop();
-                            update_ebwt(std::get<1>(curr_occ.second),1,1,std::get<2>(curr_occ.second),std::get<3>(curr_occ.second));
-                            
-                            // Update pq
-                            curr_occ.first++;
-                            std::get<2>(curr_occ.second)++;
-                            if (curr_occ.first != std::get<0>(curr_occ.second))
-                                tq.push(curr_occ);
-                        
+                        while(!lt.empty()){
+                            phrase_suffix_t &s = same_suffix[lt.top()];
+                            size_t r = lt.run();
+                            size_t ind = lt.head() - &pars.ilP[0];
+                            for(size_t j=0; j<r; ++j){
+                                update_ebwt(s.bwt_char, 1, 1, ind+j, s.st_pos);
+                            }
+                            lt.pop(r);
                         }
                     }
                 }
@@ -7,10 +7,11 @@
 #ifndef PFP_PARSE_HPP
 #define PFP_PARSE_HPP
 
-#ifndef P64
-  typedef uint32_t uint_s;
-#else
+// P64 is defined as 0 or 1 if csais.h is included, as in er-build
+#if defined(P64) && P64
   typedef uint64_t uint_s;
+#else
+  typedef uint32_t uint_s;
 #endif
 
 //#include "common.hpp"
@@ -47,13 +48,9 @@ public:
     in.close();
     //for(int i=0;i<b_st.size();++i){ std::cout << b_st[i] << " "; }
     //std::cout << "\n";
-    // compute rank and select data structures for the parse
-    rank_st = sdsl::sd_vector<>::rank_1_type(&b_st);
-    select_ilist = sdsl::sd_vector<>::select_1_type(&b_il);
     // read last positions file
     input = filename + std::string(".slast"); 
     read_file(input.c_str(), last);
-    lastLen = last.size()/IBYTES;
 
     //for(int i=0;i<lastLen;++i){ std::cout << get_last(i) << " "; }
     //std::cout << "\n";
@@ -61,6 +58,32 @@ public:
     // read first positions file
     input = filename + std::string(".spos");
     read_file(input.c_str(), first);
+    init();
+  }
+
+  /*
+   * constructor from the parse data structures kept in memory (er-build), slast and spos
+   * are the content of the .slast and .spos files. The vectors of pars are moved
+   */
+  template<class parse_t>
+  pfp_parse(parse_t &pars, std::vector<uint8_t> &slast, std::vector<uint8_t> &spos)
+  {
+    ilP.swap(pars.ilP);
+    offset.swap(pars.offset);
+    b_il = std::move(pars.b_il);
+    b_st = std::move(pars.b_st);
+    last.swap(slast);
+    first.swap(spos);
+    init();
+  }
+
+  // build the rank and select data structures
+  void init()
+  {
+    // compute rank and select data structures for the parse
+    rank_st = sdsl::sd_vector<>::rank_1_type(&b_st);
+    select_ilist = sdsl::sd_vector<>::select_1_type(&b_il);
+    lastLen = last.size()/IBYTES;
     firstLen = first.size()/IBYTES;
     bwtLen = get_myint(&first[0],firstLen,firstLen-1);
 
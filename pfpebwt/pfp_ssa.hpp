@@ -2,21 +2,178 @@
  * Code to build the the runlength eBWT and the sampled suffix array of a string collections.
  * 
  * This code is adapted from https://github.com/maxrossi91/pfp-thresholds/blob/master/include/pfp/pfp_thresholds.hpp
+ *
+ * With th > 1 threads the SA of the dictionary is split in ranges starting with a suffix
+ * having lcp < w, so that no group of identical suffixes crosses two ranges. The threads
+ * compute the runs and samples of th ranges at a time in memory. The output of a range
+ * depends on the previous ranges only through its first update of the eBWT (which may
+ * close the run of the previous ranges) and the number of eBWT characters before it, so
+ * each thread defers its first update, that is done when the outputs are concatenated in
+ * order, and the lengths and positions are then shifted. The output is the same with any th.
+ *
+ * With a sample rate S > 0 the gCA values at the offsets multiple of S in their string are
+ * also output with their eBWT positions, in eBWT order: the occurrences of the suffixes are
+ * inserted in the order of the merged inverted lists of their phrases, that are merged also
+ * for the blocks of identical suffixes when sampling.
  */
 
 #ifndef PFP_SSA_HPP
 #define PFP_SSA_HPP
 
-//#define BWTBYTES 5
+#define BWTBYTES 5
 //#define SABYTES 5
 
 #include <algorithm>
 #include <tuple>
 #include <queue>
+#include <memory>
+
+#include "loser_tree.hpp"
+extern "C" {
+#include "xerrors.h"
+}
+
+// number of ranges of the dictionary SA per thread in the parallel mode
+#define SSA_RANGES 16
 
 typedef std::tuple<bool,size_t,size_t> i_tuple;
 typedef std::pair<size_t,size_t> il_interval;
 
+// destination of the eBWT runs, of the gCA samples and of the positions of
+// the string starting characters computed by pfp_ssa
+class ssa_output{
+public:
+    virtual ~ssa_output() {}
+    // a run of the eBWT
+    virtual void run(uint8_t head, size_t length) = 0;
+    // first gCA sample of a run
+    virtual void first_sample(size_t sa) = 0;
+    // last gCA sample of a run
+    virtual void last_sample(size_t sa) = 0;
+    // eBWT position of a string starting character
+    virtual void string_start(size_t pos) = 0;
+    // gCA value sa, at an offset multiple of the sample rate, of the eBWT position pos
+    virtual void sample(size_t pos, size_t sa) = 0;
+};
+
+// output to the .head and .len files (or .ebwt if not rle), .I, .ssam and .esam files,
+// and .gsam if sampling (the sample rate, then the eBWT position and gCA value of each sample),
+// written with large buffers since we write a few bytes per run
+class ssa_files: public ssa_output{
+private:
+    bool rle;
+    // output files
+    block_writer ebwt_file;
+    block_writer ebwt_file_len;
+    block_writer ebwt_file_heads;
+    // for strings tarting positions
+    block_writer I_file;
+    // sa samples files
+    block_writer ebwt_file_ssa;
+    block_writer ebwt_file_esa;
+    // sampled gCA values file
+    block_writer ebwt_file_gsa;
+
+public:
+    ssa_files(std::string filename, bool rle_, size_t sa_rate = 0): rle(rle_)
+    {
+    	// initialize output files
+        if( rle ){
+            // HEADS file
+            ebwt_file_heads.open(filename + std::string(".head"));
+            // LENGTHS file
+            ebwt_file_len.open(filename + std::string(".len"));
+        }
+        else{
+            ebwt_file.open(filename + std::string(".ebwt"));
+        }
+        // I file
+        I_file.open(filename + std::string(".I"));
+        // starting samples file
+        ebwt_file_ssa.open(filename + std::string(".ssam"));
+        // ending samples file
+        ebwt_file_esa.open(filename + std::string(".esam"));
+        // sampled gCA values file
+        if( sa_rate > 0 ){
+            ebwt_file_gsa.open(filename + std::string(".gsam"));
+            ebwt_file_gsa.put(sa_rate, SABYTES);
+        }
+    }
+
+    void run(uint8_t head, size_t length)
+    {
+        if(rle)
+        {
+            // Write the head and the length
+            ebwt_file_heads.put(head, 1);
+            ebwt_file_len.put(length, BWTBYTES);
+        }else{
+            // write plain ebwt
+            ebwt_file.fill(head, length);
+        }
+    }
+
+    void first_sample(size_t sa)
+    {
+        ebwt_file_ssa.put(sa, SABYTES);
+    }
+
+    void last_sample(size_t sa)
+    {
+        ebwt_file_esa.put(sa, SABYTES);
+    }
+
+    void string_start(size_t pos)
+    {
+        I_file.put(pos, sizeof(pos));
+    }
+
+    void sample(size_t pos, size_t sa)
+    {
+        ebwt_file_gsa.put(pos, SABYTES);
+        ebwt_file_gsa.put(sa, SABYTES);
+    }
+
+    // flush and close the output files
+    void close()
+    {
+        ebwt_file.close();
+        ebwt_file_len.close();
+        ebwt_file_heads.close();
+        I_file.close();
+        ebwt_file_ssa.close();
+        ebwt_file_esa.close();
+        ebwt_file_gsa.close();
+    }
+};
+
+// output of a range of the dictionary SA in the parallel mode of pfp_ssa, kept in memory
+class ssa_buffer: public ssa_output{
+public:
+    std::vector<uint8_t> heads;
+    std::vector<size_t> lengths, first, last, starts;
+    std::vector<std::pair<size_t,size_t>> samples;
+
+    void run(uint8_t head, size_t length){ heads.push_back(head); lengths.push_back(length); }
+
+    void first_sample(size_t sa){ first.push_back(sa); }
+
+    void last_sample(size_t sa){ last.push_back(sa); }
+
+    void string_start(size_t pos){ starts.push_back(pos); }
+
+    void sample(size_t pos, size_t sa){ samples.push_back({pos, sa}); }
+
+    void clear(){
+        std::vector<uint8_t>().swap(heads);
+        std::vector<size_t>().swap(lengths);
+        std::vector<size_t>().swap(first);
+        std::vector<size_t>().swap(last);
+        std::vector<size_t>().swap(starts);
+        std::vector<std::pair<size_t,size_t>>().swap(samples);
+    }
+};
+
 class pfp_ssa{
 private:
     typedef struct
@@ -37,16 +194,38 @@ private:
     // run length encoded eBWT
     bool rle;
     bool sample_first;
+    // sample rate of the gCA values (0 = no samples)
+    size_t sa_rate = 0;
     
-    // output files
-    FILE *ebwt_file;
-    FILE *ebwt_file_len;
-    FILE *ebwt_file_heads;
-    // for strings tarting positions
-    FILE *I_file;
-    // sa samples files
-    FILE *ebwt_file_ssa;
-    FILE *ebwt_file_esa;
+    // output files, if not given by the caller
+    std::unique_ptr<ssa_files> files;
+    // output of the runs and samples
+    ssa_output *out;
+    // number of threads
+    int th = 1;
+
+    // parallel mode: first position of each range of saD (and saD size)
+    std::vector<size_t> cut;
+    // workers of the ranges of a round and their outputs
+    std::vector<std::unique_ptr<pfp_ssa>> workers;
+    std::vector<ssa_buffer> buf;
+
+    // worker: the first update of the eBWT is deferred
+    bool defer = false;
+    struct {
+        uint8_t next_char;
+        size_t length;
+        phrase_suffix_t curr;
+        il_interval occ;
+        i_tuple st_pos;
+    } first_update;
+
+    // struct shared via the threads of the parallel mode
+    typedef struct {
+        pfp_ssa *ssa; // main object
+        size_t k;     // range
+        size_t b;     // worker
+    } range_task;
 
 public:
 
@@ -98,6 +277,19 @@ public:
     // it returns false if the suffix is not valid
     inline void update_ebwt_sa(uint8_t next_char, size_t length_, phrase_suffix_t &curr, il_interval occ, i_tuple st_pos)
     {
+        if (defer)
+        {
+            // the state after the first update does not depend on the previous ranges,
+            // but for the run length that is fixed when merging
+            first_update = {next_char, length_, curr, occ, st_pos};
+            defer = false;
+            head = next_char;
+            p_last_occ = std::get<1>(occ);
+            prev = curr;
+            ins_sofar += length_;
+            length = length_;
+            return;
+        }
         if (head != next_char)
         {
             // update last gCA sample
@@ -129,7 +321,7 @@ public:
                 if(pars.offset[(pars.rank_st(std::get<1>(st_pos)+1)-1)] == std::get<2>(st_pos)){
                     // print the current position in the eBWT
                     start = ins_sofar-1;
-                    if(fwrite(&start,sizeof(start),1,I_file)!=1) error("I file write error");
+                    out->string_start(start);
                     // check if this position is already sampled
                     if(sample_first && length > 0)
                     {
@@ -163,12 +355,8 @@ public:
     inline void print_sa(){
 
         // skip ending sample of empty run
-        if(ins_sofar > 0){
-            if (fwrite(&esa, SABYTES, 1, ebwt_file_esa) != 1)
-                error("SA write error 1");
-        }
-        if (fwrite(&ssa, SABYTES, 1, ebwt_file_ssa) != 1)
-            error("SA write error 2");
+        if(ins_sofar > 0){ out->last_sample(esa); }
+        out->first_sample(ssa);
     }
 
     // function processing the next suffix
@@ -177,22 +365,7 @@ public:
     {
         if(length > 0)
         {
-            if(rle)
-            {
-                // Write the head
-                if (fputc(head, ebwt_file_heads) == EOF)
-                    error("BWT write error 1");
-                // Write the length
-                if (fwrite(&length, BWTBYTES, 1, ebwt_file_len) != 1)
-                    error("BWT write error 2");
-            }else{
-                // write plain ebwt
-                for(size_t i = 0; i < length; ++i)
-                {
-                    if (fputc(head, ebwt_file) == EOF)
-                        error("BWT write error 1");
-                }
-            }
+            out->run(head, length);
             // one run added
             ++runs;
         }
@@ -202,8 +375,7 @@ public:
         // compute last sample
         update_sa_sample(curr, p_last_occ, 1);
         // print last sample of the last eBWT run
-        if (fwrite(&esa, SABYTES, 1, ebwt_file_esa) != 1)
-            error("SA write error 1");
+        out->last_sample(esa);
     }
 
     // function that returns true if the suffix is valid false otherwise
@@ -215,8 +387,9 @@ public:
         
         return true;
     }
-    // function that updates the GCA-samples
-    inline void update_sa_sample(phrase_suffix_t &curr, size_t pos, bool lsam)
+    // gCA value of the suffix of curr in the occurrence pos of its phrase,
+    // st is set to the first position of its string
+    inline size_t gca(phrase_suffix_t &curr, size_t pos, size_t &st)
     {   // get offset of the phrase
         int64_t last_val = pars.get_last(pos);
         size_t rank = pars.rank_ns(last_val+1);
@@ -227,11 +400,29 @@ public:
         if( first_string_pos >  sa_tmp ){
             sa_tmp = pars.select_ns(rank+1) - ( curr.suffix_length - (last_val - first_string_pos) ) + 1;
         }
+        st = first_string_pos;
+        return sa_tmp;
+    }
+
+    // function that updates the GCA-samples
+    inline void update_sa_sample(phrase_suffix_t &curr, size_t pos, bool lsam)
+    {
+        size_t st, sa_tmp = gca(curr, pos, st);
         // update either esa or ssa
         if( lsam ){ esa = sa_tmp; }
         else { ssa = sa_tmp; }
     }
 
+    // output the sampled gCA values of the occurrences p[0..r-1] of the suffix of curr,
+    // inserted in the eBWT from position pos
+    inline void sample_occ(phrase_suffix_t &curr, const uint_s *p, size_t r, size_t pos)
+    {
+        for(size_t j=0; j<r; ++j){
+            size_t st, sa_tmp = gca(curr, p[j], st);
+            if( (sa_tmp - st) % sa_rate == 0 ){ out->sample(pos + j, sa_tmp); }
+        }
+    }
+
     // initialize first and last occurence variables
     inline void init_first_last_occ()
     {
@@ -256,50 +447,75 @@ public:
     }
 
 
-    pfp_ssa(pfp_parse &p_, dictionary &d_, std::string filename_, size_t w_, bool rle_, bool sample_first_): 
+    pfp_ssa(pfp_parse &p_, dictionary &d_, std::string filename_, size_t w_, bool rle_, bool sample_first_, int th_ = 1, size_t sa_rate_ = 0): 
         pars(p_),
         dict(d_),
         filename(filename_),
         w(w_),
         rle(rle_),
         sample_first(sample_first_),
+        sa_rate(sa_rate_),
+        th(th_),
         pos_s(0),
         head(0)
     {
-    	// initialize output files
-    	// HEADS file
-        std::string outfile;
-        if( rle ){
-    	outfile = filename + std::string(".head"); 
-    	if((ebwt_file_heads = fopen(outfile.c_str(), "w")) == nullptr)
-            error("open() file " + outfile + " failed");
-        // HEADS file
-    	outfile = filename + std::string(".len"); 
-    	if((ebwt_file_len = fopen(outfile.c_str(), "w")) == nullptr)
-            error("open() file " + outfile + " failed");
-        }
+        // initialize output files
+        files.reset(new ssa_files(filename, rle, sa_rate));
+        out = files.get();
+        compute();
+    }
+
+    // constructor writing the runs and the samples to out_ (er-build)
+    pfp_ssa(pfp_parse &p_, dictionary &d_, ssa_output &out_, size_t w_, bool sample_first_, int th_ = 1, size_t sa_rate_ = 0): 
+        pars(p_),
+        dict(d_),
+        w(w_),
+        rle(true),
+        sample_first(sample_first_),
+        sa_rate(sa_rate_),
+        out(&out_),
+        th(th_),
+        pos_s(0),
+        head(0)
+    {
+        compute();
+    }
+
+    // worker of the parallel mode writing to out_
+    pfp_ssa(pfp_ssa &m, ssa_output *out_): 
+        pars(m.pars),
+        dict(m.dict),
+        w(m.w),
+        rle(m.rle),
+        sample_first(m.sample_first),
+        sa_rate(m.sa_rate),
+        out(out_),
+        pos_s(0),
+        head(0)
+    {}
+
+    // compute the runs of the eBWT and the gCA samples
+    void compute()
+    {
+        if(th > 1){ compute_parallel(); }
         else{
-            outfile = filename + std::string(".ebwt"); 
-            if((ebwt_file = fopen(outfile.c_str(), "w")) == nullptr)
-                error("open() file " + outfile + " failed");
+            // increment the current suffix
+            inc(curr); prev = curr;
+            process(dict.saD.size());
+            // print last eBWT run and gCA sample
+            print_ebwt();
+            print_last_sa();
         }
-        // I file
-        outfile = filename + std::string(".I");
-        if((I_file = fopen(outfile.c_str(), "w")) == nullptr)
-            error("open() file " + outfile + " failed");
-        // starting samples file
-        outfile = filename + std::string(".ssam"); 
-        if((ebwt_file_ssa = fopen(outfile.c_str(), "w")) == nullptr)
-            error("open() file " + outfile + " failed");
-        // ending samples file
-        outfile = filename + std::string(".esam"); 
-        if((ebwt_file_esa = fopen(outfile.c_str(), "w")) == nullptr)
-            error("open() file " + outfile + " failed");
+        // close output files
+        if(files){ files->close(); }
+        files.reset();
+    }
 
-        // increment the current suffix
-        inc(curr); prev = curr;
+    // compute the runs and samples of the suffixes from curr to saD[e-1]
+    void process(size_t e)
+    {
         // iterate over SA of dict
-        while (curr.i < dict.saD.size())
+        while (curr.i < e)
         {
             // if the current suffix is valid process it
             if(is_valid(curr))
@@ -317,7 +533,7 @@ public:
                 // initialize the variable for the next suffix to process
                 phrase_suffix_t next = curr;
                 // process all identical suffixes in one block
-                while (inc(next) && (dict.lcpD[next.i] >= curr.suffix_length))
+                while (inc(next) && dict.lcp_at_least(next.i, curr.suffix_length))
                 {
                     // if the two suffixes have the same length
                     if (next.suffix_length == curr.suffix_length)
@@ -337,6 +553,20 @@ public:
                     {
                         block_length += dict.occ[curr.phrase-1];
                     }
+                    if(sa_rate > 0){
+                        // the occurrences of the block are inserted in the order of the merged inverted lists
+                        loser_tree<uint_s> lt;
+                        for (auto s: same_suffix){
+                            lt.push(&pars.ilP[pars.select_ilist(s.phrase)], &pars.ilP[pars.select_ilist(s.phrase+1)]);
+                        }
+                        lt.build();
+                        for(size_t pos = ins_sofar; !lt.empty(); ){
+                            size_t r = lt.run();
+                            sample_occ(curr, lt.head(), r, pos);
+                            pos += r;
+                            lt.pop(r);
+                        }
+                    }
                     update_ebwt_sa(same_suffix[0].bwt_char,block_length,same_suffix[0],
                                    std::make_pair(first_occ,last_occ),std::make_tuple(0, 0, 0));
                 }   
@@ -345,60 +575,39 @@ public:
                 {       
                     //suffix not starting with a character occurring at the beginning of 
                     // a input sequence
+                    // merge the inverted lists of the phrases
+                    loser_tree<uint_s> lt;
+                    for (auto s: same_suffix){
+                        size_t begin = pars.select_ilist(s.phrase);
+                        size_t end = pars.select_ilist(s.phrase+1);
+                        lt.push(&pars.ilP[begin], &pars.ilP[end]);
+                    }
+                    lt.build();
                     if(!st_chars){
-                        typedef std::pair<uint_s *, std::pair<uint_s *, uint8_t>> pq_t;
-                        // using lambda to compare elements.
-                        auto cmp = [](const pq_t &lhs, const pq_t &rhs) {
-                            return *lhs.first > *rhs.first;
-                        };
-                        std::priority_queue<pq_t, std::vector<pq_t>, decltype(cmp)> pq(cmp);
-                        
-                        for (auto s: same_suffix){
-                            size_t begin = pars.select_ilist(s.phrase);
-                            size_t end = pars.select_ilist(s.phrase+1);
-                            pq.push({&pars.ilP[begin], {&pars.ilP[end], s.bwt_char}});
+                        // a run of occurrences of the same phrase is inserted at once,
+                        // its first and last occurrence give the gCA samples
+                        while(!lt.empty()){
+                            size_t r = lt.run();
+                            const uint_s *p = lt.head();
+                            if(sa_rate > 0){ sample_occ(curr, p, r, ins_sofar); }
+                            update_ebwt_sa(same_suffix[lt.top()].bwt_char,r,curr,
+                                           std::make_pair(p[0],p[r-1]),std::make_tuple(0, 0, 0));
+                            lt.pop(r);
                         }
-                        while(!pq.empty()){
-                            auto curr_occ = pq.top();
-                            pq.pop();
-
-                            //if(head != curr_occ.second.second) update_ssa(curr, *curr_occ.first);
-                            update_ebwt_sa(curr_occ.second.second,1,curr,
-                                           std::make_pair(*curr_occ.first,*curr_occ.first),std::make_tuple(0, 0, 0));
-                            //update_esa(curr, *curr_occ.first);
-                            
-                            // Update pq
-                            curr_occ.first++;
-                            if (curr_occ.first != curr_occ.second.first)
-                                pq.push(curr_occ);
-                        
-                        }                      
                     }else{
                         //check and store the positions at which the start of string characters
                         //are inserted in the ebwt (we need them to invert the ebwt)
-                        typedef std::pair<uint_s *, std::tuple<uint_s *, uint8_t, size_t, size_t>> tq_t;
-                        
-                        auto cmp2 = [](const tq_t &lhs, const tq_t &rhs) {
-                            return *lhs.first > *rhs.first;
-                        };
-                        std::priority_queue<tq_t, std::vector<tq_t>, decltype(cmp2)> tq(cmp2);
-                        for (auto s: same_suffix){
-                            size_t begin = pars.select_ilist(s.phrase);
-                            size_t end = pars.select_ilist(s.phrase+1);
-                            tq.push({&pars.ilP[begin], std::make_tuple(&pars.ilP[end], s.bwt_char, begin, s.st_pos)});
-                        }
-                        while(!tq.empty()){
-                            auto curr_occ = tq.top();
-                            tq.pop();
-                            update_ebwt_sa(std::get<1>(curr_occ.second),1,curr,std::make_pair(*curr_occ.first,*curr_occ.first),
-                                           std::make_tuple(1,std::get<2>(curr_occ.second),std::get<3>(curr_occ.second)));
-                            
-                            // Update pq
-                            curr_occ.first++;
-                            std::get<2>(curr_occ.second)++;
-                            if (curr_occ.first != std::get<0>(curr_occ.second))
-                                tq.push(curr_occ);
-                        
+                        while(!lt.empty()){
+                            phrase_suffix_t &s = same_suffix[lt.top()];
+                            size_t r = lt.run();
+                            const uint_s *p = lt.head();
+                            size_t ind = p - &pars.ilP[0];
+                            for(size_t j=0; j<r; ++j){
+                                if(sa_rate > 0){ sample_occ(curr, p+j, 1, ins_sofar); }
+                                update_ebwt_sa(s.bwt_char,1,curr,std::make_pair(p[j],p[j]),
+                                               std::make_tuple(1,ind+j,s.st_pos));
+                            }
+                            lt.pop(r);
                         }
                     }
                 }
@@ -408,17 +617,88 @@ public:
             // increment the suffix if the previous one was not valid
             else { inc(curr); }
         }
+    }
+
+    static void *compute_task(void *dx)
+    {
+        range_task *t = (range_task *) dx;
+        pfp_ssa &m = *t->ssa;
+        m.buf[t->b].clear();
+        m.workers[t->b].reset(new pfp_ssa(m, &m.buf[t->b]));
+        pfp_ssa &wk = *m.workers[t->b];
+        wk.defer = true;
+        wk.curr.i = m.cut[t->k]-1; wk.inc(wk.curr);
+        wk.process(m.cut[t->k+1]);
+        return NULL;
+    }
+
+    // append the output of the worker wk, computed after its first update
+    void merge(pfp_ssa &wk, ssa_buffer &b)
+    {
+        // no valid suffix in the range
+        if(wk.defer) return;
+        size_t base = ins_sofar;
+        update_ebwt_sa(wk.first_update.next_char, wk.first_update.length, wk.first_update.curr,
+                       wk.first_update.occ, wk.first_update.st_pos);
+        // the worker replaced the length of the current run with the one of its first update
+        size_t pending = length - wk.first_update.length;
+        for(size_t j=0; j<b.heads.size(); ++j){
+            out->run(b.heads[j], (j==0) ? b.lengths[j] + pending : b.lengths[j]);
+        }
+        for(auto x: b.first){ out->first_sample(x); }
+        for(auto x: b.last){ out->last_sample(x); }
+        for(auto x: b.starts){ out->string_start(base + x); }
+        for(auto &x: b.samples){ out->sample(base + x.first, x.second); }
+        length = b.heads.empty() ? wk.length + pending : wk.length;
+        head = wk.head;
+        prev = wk.prev;
+        p_last_occ = wk.p_last_occ;
+        ins_sofar = base + wk.ins_sofar;
+        runs += wk.runs;
+    }
+
+    // compute the runs of the eBWT and the gCA samples with th threads
+    void compute_parallel()
+    {
+        size_t n = dict.saD.size();
+        // split saD before suffixes having lcp < w
+        size_t nr = (size_t)th*SSA_RANGES;
+        cut.assign(1,1);
+        for(size_t k=1; k<nr; ++k){
+            size_t i = (n/nr*k > cut.back()) ? n/nr*k : cut.back()+1;
+            while(i < n && dict.lcp_at_least(i, w)){ ++i; }
+            if(i >= n) break;
+            cut.push_back(i);
+        }
+        cut.push_back(n);
+        nr = cut.size()-1;
+        // initial state as in the sequential version
+        inc(curr); prev = curr;
+        workers.resize(th);
+        buf.resize(th);
+        // th ranges at a time, one thread per range
+        for(size_t k0=0; k0<nr; k0+=th){
+            size_t k1 = std::min(nr, k0+th);
+            pthread_t t[k1-k0];
+            range_task d[k1-k0];
+            for(size_t k=k0; k<k1; ++k){
+                d[k-k0].ssa = this; d[k-k0].k = k; d[k-k0].b = k-k0;
+                xpthread_create(&t[k-k0],NULL,&compute_task,&d[k-k0],__LINE__,__FILE__);
+            }
+            for(size_t k=k0; k<k1; ++k)
+                xpthread_join(t[k-k0],NULL,__LINE__,__FILE__);
+            // concatenate the outputs in order
+            for(size_t k=k0; k<k1; ++k){
+                merge(*workers[k-k0], buf[k-k0]);
+                // the last suffix is used for the last sample
+                if(k == nr-1){ curr = workers[k-k0]->curr; }
+                workers[k-k0].reset();
+                buf[k-k0].clear();
+            }
+        }
         // print last eBWT run and gCA sample
         print_ebwt();
         print_last_sa();
-        // close output files
-        fclose(I_file);
-        // close rle lengths file if rle was used
-        if(rle){ fclose(ebwt_file_len); fclose(ebwt_file_heads);}
-        else { fclose(ebwt_file); }   
-        // close gCA sample files
-        fclose(ebwt_file_ssa);
-        fclose(ebwt_file_esa); 
     }
 };
 
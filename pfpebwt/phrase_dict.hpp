@@ -0,0 +1,150 @@
+/*
+ * Dictionary of the PFP phrases keyed by their KR hash.
+ *
+ * The dictionary is split in DICT_SHARDS shards selected by the hash, each
+ * one an open addressing hash table with linear probing. The phrases are
+ * stored in insertion order in a vector, the table only stores their hash
+ * and index, so that a lookup reads one table slot and one phrase.
+ * The threads of the parser fill their own dictionaries, that are merged
+ * shard by shard in parallel.
+ */
+
+#ifndef PHRASE_DICT_HPP_
+#define PHRASE_DICT_HPP_
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <stdint.h>
+
+// number of shards of the phrase dictionary
+#define DICT_SHARDS 64
+
+template<class V>
+class phrase_table {
+
+public:
+  typedef std::pair<uint64_t,V> entry;
+  typedef typename std::vector<entry>::iterator iterator;
+
+  // return the value of hash, inserted is true if hash was not in the table
+  V& insert(uint64_t hash, bool& inserted) {
+    if(2*(entries.size()+1) > ids.size()) grow();
+    size_t i = slot(hash);
+    while(ids[i] != 0) {
+      if(keys[i] == hash) { inserted = false; return entries[ids[i]-1].second; }
+      i = (i+1) & mask;
+    }
+    entries.emplace_back(hash, V());
+    keys[i] = hash; ids[i] = entries.size();
+    inserted = true;
+    return entries.back().second;
+  }
+
+  // return the value of hash, throw std::out_of_range if hash is not in the table
+  V& at(uint64_t hash) {
+    if(!ids.empty()) {
+      size_t i = slot(hash);
+      while(ids[i] != 0) {
+        if(keys[i] == hash) return entries[ids[i]-1].second;
+        i = (i+1) & mask;
+      }
+    }
+    throw std::out_of_range("phrase_table::at");
+  }
+
+  size_t size() const { return entries.size(); }
+
+  iterator begin() { return entries.begin(); }
+
+  iterator end() { return entries.end(); }
+
+  void clear() {
+    std::vector<uint64_t>().swap(keys);
+    std::vector<uint32_t>().swap(ids);
+    std::vector<entry>().swap(entries);
+    mask = 0; shift = 64;
+  }
+
+private:
+  // multiplicative hashing, the KR hashes of the same shard share their remainder
+  inline size_t slot(uint64_t hash) const { return (hash * 0x9E3779B97F4A7C15ULL) >> shift; }
+
+  // double the table, the load factor is at most 1/2
+  void grow() {
+    size_t n = ids.empty() ? 1024 : 2*ids.size();
+    keys.assign(n, 0);
+    ids.assign(n, 0);
+    mask = n-1; shift = 64 - __builtin_ctzll(n);
+    for(size_t j=0; j<entries.size(); ++j) {
+      size_t i = slot(entries[j].first);
+      while(ids[i] != 0) i = (i+1) & mask;
+      keys[i] = entries[j].first; ids[i] = j+1;
+    }
+  }
+
+  // hash and index+1 (0 = empty slot) of the phrase of each slot
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> ids;
+  // phrases in insertion order
+  std::vector<entry> entries;
+  size_t mask = 0, shift = 64;
+};
+
+template<class V>
+class phrase_dict {
+
+public:
+  typedef phrase_table<V> table;
+
+  phrase_dict(): shards(DICT_SHARDS) {}
+
+  // return the value of hash, inserted is true if hash was not in the dictionary
+  V& insert(uint64_t hash, bool& inserted) { return shards[shard_of(hash)].insert(hash, inserted); }
+
+  // return the value of hash, throw std::out_of_range if hash is not in the dictionary
+  V& at(uint64_t hash) { return shards[shard_of(hash)].at(hash); }
+
+  size_t size() const {
+    size_t n = 0;
+    for(auto& s: shards) n += s.size();
+    return n;
+  }
+
+  // i-th shard
+  table& shard(size_t i) { return shards[i]; }
+
+  static inline size_t shard_of(uint64_t hash) { return hash % DICT_SHARDS; }
+
+  // iterator over the phrases of all the shards
+  class iterator {
+  public:
+    iterator(phrase_dict *d_, size_t s_): d(d_), s(s_) {
+      if(s < DICT_SHARDS) { it = d->shards[s].begin(); skip(); }
+    }
+    typename table::entry& operator*() { return *it; }
+    typename table::entry* operator->() { return &*it; }
+    iterator& operator++() { ++it; skip(); return *this; }
+    bool operator!=(const iterator& o) const { return s != o.s || (s < DICT_SHARDS && it != o.it); }
+  private:
+    // move to the next non empty shard
+    void skip() {
+      while(it == d->shards[s].end()) {
+        if(++s == DICT_SHARDS) return;
+        it = d->shards[s].begin();
+      }
+    }
+    phrase_dict *d;
+    size_t s;
+    typename table::iterator it;
+  };
+
+  iterator begin() { return iterator(this, 0); }
+
+  iterator end() { return iterator(this, DICT_SHARDS); }
+
+private:
+  std::vector<table> shards;
+};
+
+#endif
@@ -2,6 +2,9 @@
  * This code is adapted from https://github.com/alshai/Big-BWT/blob/master/utils.h
  */
 
+#ifndef UTILS_H
+#define UTILS_H
+
 // special symbols used by the construction algorithm:
 //   they cannot appear in the input file 
 //   the 0 symbol is used in the final BWT file as the EOF char  
@@ -48,3 +51,4 @@ mFile *mopen_aux_file(const char *base, const char *ext, int nsegs);
 int mfclose(mFile *f);
 size_t mfread(void *ptr, size_t size, size_t nmemb, mFile *f);
 
+#endif
@@ -0,0 +1,192 @@
+/*
+ * Predecessor structure on a set of positions with the interface of sd_vector.
+ *
+ * It is an alternative to sd_vector for the samples of pred_ebwt, that trades
+ * space for latency. The positions are stored sorted in a plain array, so that
+ * select is a single access, and a directory stores for each bucket of 2^shift
+ * positions the number of elements before it (one to two elements per bucket
+ * on average, so the directory has half to one entry per element).
+ * A rank query reads the directory entry and scans the elements of its bucket.
+ */
+
+#ifndef PRED_ARRAY_HPP_
+#define PRED_ARRAY_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#include "sd_vector.hpp"
+#include "mm_file.hpp"
+
+// buckets with at most this many elements are scanned without branches
+#define PRED_SCAN 16
+
+class pred_array{
+
+public:
+	// empty constructor
+	pred_array(){}
+	// constructor from the sorted positions of the set bits
+	pred_array(std::vector<uint_t>& onset, uint_t bsize){
+		std::vector<uint_t> ones(onset.begin(), onset.end());
+		onset.clear();
+		build(ones, bsize);
+	}
+	// constructor from a bitvector supporting rank and select (e.g. sd_vector)
+	template<class bv_t>
+	pred_array(bv_t& bv){
+		uint64_t n = bv.size();
+		std::vector<uint_t> ones;
+		if(n > 0){
+			uint64_t nones = bv.rank1(n);
+			ones.resize(nones);
+			for(uint64_t i=0; i<nones; ++i){ ones[i] = bv.select1(i); }
+		}
+		build(ones, n);
+	}
+
+	uint_t size(){
+		// return bitvector length
+		return u;
+	}
+
+	/*
+	 * number of set bits before position i
+	 */
+	uint_t rank1(uint_t i){
+		if(i >= u) return pos.size();
+		uint64_t b = uint64_t(i) >> shift;
+		uint64_t k = dir[b], e = dir[b+1];
+		if(e - k > PRED_SCAN){ return std::lower_bound(pos.data() + k, pos.data() + e, i) - pos.data(); }
+		// the elements of the bucket are sorted, count the ones before i
+		uint64_t c = k;
+		for(; k<e; ++k){ c += pos[k] < i; }
+		return c;
+	}
+
+	/*
+	 * position of the (i+1)-th set bit
+	 */
+	uint_t select1(uint_t i){
+		return pos[i];
+	}
+
+	uint_t at(uint_t i){
+		return rank1(i+1) - rank1(i);
+	}
+
+	uint_t gapAt(uint_t i){
+		if(i==0){ return select1(0)+1; }
+		return select1(i)-select1(i-1);
+	}
+
+	/*
+	 * prefetch the directory entry and the elements read by rank1(i), the
+	 * position of the elements is estimated assuming that they are evenly spread
+	 */
+	void prefetch(uint_t i){
+		if(i >= u) return;
+		__builtin_prefetch(dir.data() + (uint64_t(i) >> shift));
+		__builtin_prefetch(pos.data() + uint64_t((double)i / u * pos.size()));
+	}
+
+	/*
+	 * prefetch the element read by select1(i)
+	 */
+	void prefetch_select(uint_t i){
+		__builtin_prefetch(pos.data() + i);
+	}
+
+	/* serialize the structure to the ostream
+	 * \param out	 the ostream
+	 */
+	uint_t serialize(std::ostream& out){
+
+		uint_t w_bytes = 0;
+
+		out.write((char*)&u, sizeof(u));
+		out.write((char*)&shift, sizeof(shift));
+		w_bytes += sizeof(u) + sizeof(shift);
+
+		w_bytes += write_array(out, pos);
+		w_bytes += write_array(out, dir);
+
+		return w_bytes;
+	}
+
+	/* load the structure from the istream
+	 * \param in the istream
+	 */
+	void load(std::istream& in) {
+
+		in.read((char*)&u, sizeof(u));
+		in.read((char*)&shift, sizeof(shift));
+		pos = read_array(in);
+		dir = read_array(in);
+	}
+
+	/*
+	 * store the structure in a mapped file
+	 */
+	void write_mm(mm_writer &w) const {
+		w.value(u); w.value(shift);
+		pos.write(w);
+		dir.write(w);
+	}
+
+	/*
+	 * map the structure from a mapped file
+	 */
+	void map(mm_reader &r){
+		u = r.value<uint64_t>(); shift = r.value<uint64_t>();
+		pos.map(r);
+		dir.map(r);
+	}
+
+private:
+	// build the structure from the sorted positions of the set bits
+	void build(std::vector<uint_t> &ones, uint64_t n){
+		u = n;
+		uint64_t m = ones.size();
+		// between one and two elements per bucket on average, the directory has
+		// between m/2 and m entries
+		shift = 1;
+		while(m > 0 and (u >> (shift+1)) >= (m+1)/2){ shift++; }
+		// the last entry closes the last bucket
+		std::vector<uint_t> dir_v((u >> shift) + 2);
+		uint64_t k = 0;
+		for(uint64_t b=0; b<dir_v.size(); ++b){
+			// elements before position b*2^shift
+			while(k < m and ones[k] < (b << shift)){ k++; }
+			dir_v[b] = k;
+		}
+		pos = mm_array<uint_t>(std::move(ones));
+		dir = mm_array<uint_t>(std::move(dir_v));
+	}
+
+	// write the length and the elements of an array
+	static uint_t write_array(std::ostream& out, const mm_array<uint_t>& a){
+		uint64_t n = a.size();
+		out.write((char*)&n, sizeof(n));
+		out.write((char*)a.data(), n*sizeof(uint_t));
+		return sizeof(n) + n*sizeof(uint_t);
+	}
+
+	// read an array written by write_array
+	static mm_array<uint_t> read_array(std::istream& in){
+		uint64_t n = 0;
+		in.read((char*)&n, sizeof(n));
+		std::vector<uint_t> v(n);
+		in.read((char*)v.data(), n*sizeof(uint_t));
+		return mm_array<uint_t>(std::move(v));
+	}
+
+	// bitvector length and log2 of the bucket size
+	uint64_t u = 0, shift = 1;
+	// sorted positions of the set bits
+	mm_array<uint_t> pos;
+	// number of elements before each bucket
+	mm_array<uint_t> dir;
+};
+
+#endif
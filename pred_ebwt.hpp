@@ -12,6 +12,7 @@
 #include <tuple>
 #include <sdsl/int_vector.hpp>
 #include "sd_vector.hpp"
+#include "mm_file.hpp"
 
 /*
  *  give bitsize we need to store x
@@ -35,11 +36,31 @@ class sort_indices
      bool operator()(uint_t i, uint_t j) const { return mparr[i]<mparr[j]; }
 };
 
+/*
+ * bv_t: compressed bitvector type (sd_vector, or ef_vector for the memory mapped index)
+ * iv_t: integer vector type (sdsl::int_vector<>, or packed_vector for the memory mapped index)
+ */
+template<class bv_t = sd_vector, class iv_t = sdsl::int_vector<>>
 class pred_ebwt{
 
+	template<class, class> friend class pred_ebwt;
+
 public:
 	// empty constructor
 	pred_ebwt(){}
+	/*
+	 *  constructor that copies a predecessor data structure using different data
+	 *  structures, used to convert a loaded index to the memory mapped layout
+	 */
+	template<class bv2_t, class iv2_t>
+	pred_ebwt(pred_ebwt<bv2_t,iv2_t>& other){
+		pred = bv_t(other.pred);
+		delim = bv_t(other.delim);
+		samples_last = iv_t(other.samples_last);
+		first_to_run = iv_t(other.first_to_run);
+		phi_rec = iv_t(other.phi_rec);
+		rec_shift = other.rec_shift;
+	}
 	/*
  	 *  takes in input the files containin the starting and ending sample
  	 *  and the string offsets and construct predecessor data structure
@@ -104,6 +125,8 @@ public:
 		}
 		// free memory
 		samples_last_vec.clear();
+		construct_rank_select_dt();
+		build_records();
 	}
 
 	// 2nd constructor
@@ -111,7 +134,6 @@ public:
 		      int isize, bool verbose = false, bool first = false){
 		// input vectors
 		std::vector<uint_t> samples_first_vec;
-		std::vector<uint_t> indices;
 		// set BWT length
 		// BWT_length = BWT_length_;
 		// construct bit vector of string delimiters
@@ -127,58 +149,7 @@ public:
 			s_sample_file.read(reinterpret_cast<char*>(&currSam), isize);
 			samples_first_vec[i] = (uint_t)currSam;
 		}
-		indices.reserve(r);
-		for(uint_t i=0;i<r;++i){ indices.push_back(i); }
-		// sort indices
-		std::sort(indices.begin(), indices.end(), sort_indices(&samples_first_vec[0]));
-		// compute size necessary to store ending samples and first_to_run data structure
-		int log_r = bitsize(uint64_t(r));
-		int log_n = bitsize(uint64_t(BWT_length));
-		// print some statistics
-		if(verbose)
-		{
-			std::cout << "Value n/(sampled r) = " << double(BWT_length)/r << std::endl;
-			std::cout << "Number of bits to store first_to_run vector = " << log_r << std::endl;
-			std::cout << "Number of bits to store last samples vector = " << log_n << std::endl;
-		}
-		// create first_to_run vector and sorted samples vector
-		first_to_run = sdsl::int_vector<>(r,0,log_r); 
-		for(uint_t i=0;i<r;++i){
-			first_to_run[i] = indices[i];
-			indices[i] = samples_first_vec[indices[i]];
-		}
-		// free memory
-		samples_first_vec.clear();
-		// create compressed bit vector of the sorted first samples
-		pred = sd_vector(indices,BWT_length);
-		// check sample correctness
-		if(!first)
-		{
-			delim.construct_select_ds();
-			delim.construct_rank_ds();
-			pred.construct_rank_ds();
-			uint_t prnk = 0;
-			for(uint_t i=1; i<delim.rank1(delim.size()); ++i){
-				uint_t rnk = pred.rank1(delim.select1(i));
-				if(prnk == rnk){
-					std::cerr << "Error in .ssam file, sample missing! Please restart computation using --first flag.\n";
-					std::cerr << "Sample missing in string number: " << i << "\n";
-					exit(1);
-				}
-				prnk = rnk;
-			}
-		}
-		else
-		{
-			delim.construct_select_ds();
-			delim.construct_rank_ds();
-			for(uint_t i=0; i<delim.rank1(delim.size())-1; ++i){
-				if( !pred.at(delim.select1(i)) )
-				{ std::cerr << "Error in .ssam file, sample missing in string number: " << i+1 << "\n";
-				  exit(1);
-				}
-			}
-		}
+		int log_n = build_first(samples_first_vec, BWT_length, verbose, first);
 		//text positions corresponding to last characters in BWT runs, in BWT order
 		samples_last = sdsl::int_vector<>(r,0,log_n); 
 		// construct last samples data structure
@@ -190,12 +161,31 @@ public:
 		}
 		// close stream
 		e_sample_file.close();
+		construct_rank_select_dt();
+		build_records();
+	}
+
+	/*
+	 *  constructor from the first and last samples and the string offsets
+	 *  kept in memory (er-build)
+	 */
+	pred_ebwt(std::vector<uint_t>& samples_first_vec, std::vector<uint_t>& samples_last_vec, std::vector<uint_t>& onset_vec,
+		      uint_t BWT_length, bool verbose = false, bool first = false){
+		// construct bit vector of string delimiters
+		delim = sd_vector(onset_vec,BWT_length+1);
+		uint_t r = samples_first_vec.size();
+		int log_n = build_first(samples_first_vec, BWT_length, verbose, first);
+		//text positions corresponding to last characters in BWT runs, in BWT order
+		samples_last = sdsl::int_vector<>(r,0,log_n); 
+		for(uint_t i=0;i<r;++i){ samples_last[i] = samples_last_vec[i]; }
+		std::vector<uint_t>().swap(samples_last_vec);
+		construct_rank_select_dt();
+		build_records();
 	}
 
 	/*
  	 *  construct rank select data structures for all bitvectors
  	 */
-	/*
 	void construct_rank_select_dt(){
 		// rank select for main bitvector
 		pred.construct_rank_ds();
@@ -203,7 +193,7 @@ public:
 		// rank select for main bitvector
 		delim.construct_rank_ds();
 		delim.construct_select_ds();
-	}*/
+	}
 
 	/*
  	 *  compute the rank of the circular predecessor of i. Returns a tuple containing
@@ -241,6 +231,89 @@ public:
 		}
 	} 
 
+	/*
+ 	 *  compute the Phi records: for the sample of rank jr, the last sample s of the
+ 	 *  run before its run, and the smallest distance from the sample and from s to
+ 	 *  the end of their strings (the room). A Phi step from a position at distance
+ 	 *  delta < room from the sample returns s + delta. The room is stored in the
+ 	 *  low rec_shift bits of the record, capped at the largest distance between
+ 	 *  two consecutive samples, that delta never reaches
+ 	 */
+	void build_records(){
+		uint_t r = first_to_run.size();
+		uint64_t n = pred.size(), gap = 1;
+		for(uint_t jr=0; jr<r; ++jr){
+			uint64_t next = (jr+1 < r) ? pred.select1(jr+1) : n;
+			gap = std::max(gap, next - pred.select1(jr));
+		}
+		int ws = bitsize(uint64_t(delim.size())), wr = bitsize(gap);
+		// the record fits in a word, the larger rooms are capped
+		if(ws + wr > 64){ wr = 64 - ws; gap = (1ULL << wr) - 1; }
+		rec_shift = wr;
+		sdsl::int_vector<> rec(r, 0, ws + wr);
+		for(uint_t jr=0; jr<r; ++jr){
+			uint_t f = first_to_run[jr];
+			// the first run has no previous run
+			if(f == 0) continue;
+			uint64_t j = pred.select1(jr), s = samples_last[f-1];
+			uint64_t room = std::min(next_start_pos(j) - j, next_start_pos(s) - s);
+			rec[jr] = (s << wr) | std::min(room, gap);
+		}
+		phi_rec = iv_t(rec);
+	}
+
+	/*
+ 	 *  return the rank of the predecessor of i plus one (0 if there is none)
+ 	 */
+	uint_t pred_rank(uint_t i){
+		return pred.rank1(i+1);
+	}
+
+	/*
+ 	 *  Phi step from the position at distance delta from the sample of rank jr:
+ 	 *  return false if the result crosses a string boundary, and it must be
+ 	 *  computed with circular_rank_predecessor_tuple
+ 	 */
+	inline bool phi_step(uint_t jr, uint_t delta, uint_t &res){
+		uint_t room;
+		phi_record(jr, res, room);
+		if(delta >= room) return false;
+		res += delta;
+		return true;
+	}
+
+	/*
+ 	 *  prefetch the predecessor structure at position i
+ 	 */
+	void prefetch(uint_t i){
+		pred.prefetch(i);
+	}
+
+	/*
+ 	 *  prefetch the position and the Phi record of the sample of rank jr
+ 	 */
+	void prefetch_sample(uint_t jr){
+		pred.prefetch_select(jr);
+		prefetch_int(phi_rec, jr);
+	}
+
+	/*
+ 	 *  return in s and room the Phi record of the sample of rank jr
+ 	 */
+	inline void phi_record(uint_t jr, uint_t &s, uint_t &room){
+		uint64_t x = phi_rec[jr];
+		s = x >> rec_shift;
+		room = x & ((1ULL << rec_shift) - 1);
+	}
+
+	/*
+ 	 *  return the position of the sample following the sample of rank jr
+ 	 *  (the eBWT length if it is the last one)
+ 	 */
+	uint_t next_sample(uint_t jr){
+		return jr+1 < first_to_run.size() ? pred.select1(jr+1) : pred.size();
+	}
+
 	/*
  	 *  compute the rank of the circular predecessor of i. If the first position
  	 *  is always sampled than we can just take the first predecessor.
@@ -271,6 +344,21 @@ public:
 		return delim.select1(delim.rank1(i+1)-1);
 	}
 
+	/*
+		return the index of the string containing position i
+	*/
+	uint_t string_id(uint_t i){
+		return delim.rank1(i+1)-1;
+	}
+
+	/*
+		return starting point of the string with index id
+		(the eBWT length if id is the number of strings)
+	*/
+	uint_t string_start(uint_t id){
+		return delim.select1(id);
+	}
+
 	/*
 		return no. of runs of the ebwt
 	*/
@@ -337,13 +425,141 @@ public:
 		first_to_run.load(in);
 	}
 
+	/* store the structure in a mapped file
+	 * \param w	 the mapped file writer
+	 */
+	void write_mm(mm_writer& w) {
+
+		pred.write_mm(w);
+		delim.write_mm(w);
+		samples_last.write_mm(w);
+		first_to_run.write_mm(w);
+	}
+
+	/* map the structure from a mapped file
+	 * \param r	 the mapped file reader
+	 */
+	void map(mm_reader& r) {
+
+		pred.map(r);
+		delim.map(r);
+		samples_last.map(r);
+		first_to_run.map(r);
+	}
+
+	/*  serialize the Phi records to the ostream, they are stored at the end
+	 *  of the index so that they can be rebuilt for the older indexes
+	 *  \param out	 the ostream
+	 */
+	uint_t serialize_records(std::ostream& out){
+		out.write((char*)&rec_shift,sizeof(rec_shift));
+		return sizeof(rec_shift) + phi_rec.serialize(out);
+	}
+
+	/* load the Phi records from the istream
+	 * \param in the istream
+	 */
+	void load_records(std::istream& in) {
+		in.read((char*)&rec_shift,sizeof(rec_shift));
+		phi_rec.load(in);
+	}
+
+	/* store the Phi records in a mapped file
+	 * \param w	 the mapped file writer
+	 */
+	void write_records_mm(mm_writer& w) {
+		w.value(rec_shift);
+		phi_rec.write_mm(w);
+	}
+
+	/* map the Phi records from a mapped file
+	 * \param r	 the mapped file reader
+	 */
+	void map_records(mm_reader& r) {
+		rec_shift = r.value<uint64_t>();
+		phi_rec.map(r);
+	}
+
 private:
+	// prefetch the i-th integer of v
+	template<class v_t>
+	static void prefetch_int(v_t& v, uint64_t i){ v.prefetch(i); }
+
+	static void prefetch_int(sdsl::int_vector<>& v, uint64_t i){ __builtin_prefetch(v.data() + (i*v.width())/64); }
+
+	/*
+	 *  construct the predecessor bitvector and the first_to_run vector from the first
+	 *  samples, check that each string is sampled and return the bits of a sample
+	 */
+	int build_first(std::vector<uint_t>& samples_first_vec, uint_t BWT_length, bool verbose, bool first){
+		std::vector<uint_t> indices;
+		uint_t r = samples_first_vec.size();
+		indices.reserve(r);
+		for(uint_t i=0;i<r;++i){ indices.push_back(i); }
+		// sort indices
+		std::sort(indices.begin(), indices.end(), sort_indices(&samples_first_vec[0]));
+		// compute size necessary to store ending samples and first_to_run data structure
+		int log_r = bitsize(uint64_t(r));
+		int log_n = bitsize(uint64_t(BWT_length));
+		// print some statistics
+		if(verbose)
+		{
+			std::cout << "Value n/(sampled r) = " << double(BWT_length)/r << std::endl;
+			std::cout << "Number of bits to store first_to_run vector = " << log_r << std::endl;
+			std::cout << "Number of bits to store last samples vector = " << log_n << std::endl;
+		}
+		// create first_to_run vector and sorted samples vector
+		first_to_run = sdsl::int_vector<>(r,0,log_r); 
+		for(uint_t i=0;i<r;++i){
+			first_to_run[i] = indices[i];
+			indices[i] = samples_first_vec[indices[i]];
+		}
+		// free memory
+		std::vector<uint_t>().swap(samples_first_vec);
+		// create compressed bit vector of the sorted first samples
+		pred = sd_vector(indices,BWT_length);
+		// check sample correctness
+		if(!first)
+		{
+			delim.construct_select_ds();
+			delim.construct_rank_ds();
+			pred.construct_rank_ds();
+			uint_t prnk = 0;
+			for(uint_t i=1; i<delim.rank1(delim.size()); ++i){
+				uint_t rnk = pred.rank1(delim.select1(i));
+				if(prnk == rnk){
+					std::cerr << "Error in .ssam file, sample missing! Please restart computation using --first flag.\n";
+					std::cerr << "Sample missing in string number: " << i << "\n";
+					exit(1);
+				}
+				prnk = rnk;
+			}
+		}
+		else
+		{
+			delim.construct_select_ds();
+			delim.construct_rank_ds();
+			for(uint_t i=0; i<delim.rank1(delim.size())-1; ++i){
+				if( !pred.at(delim.select1(i)) )
+				{ std::cerr << "Error in .ssam file, sample missing in string number: " << i+1 << "\n";
+				  exit(1);
+				}
+			}
+		}
+		return log_n;
+	}
+
 	// the predecessor structure on positions corresponding to first chars in BWT runs
-	sd_vector pred, delim;
+	bv_t pred, delim;
 	// text positions corresponding to last characters in BWT runs, in BWT order
-	sdsl::int_vector<> samples_last; 
+	iv_t samples_last; 
 	// stores the BWT run (0...R-1) corresponding to each position in pred, in text order
-	sdsl::int_vector<> first_to_run; 
+	iv_t first_to_run; 
+	// Phi records of each position in pred, in text order: the last sample of the
+	// previous run and (low rec_shift bits) the distance within which Phi does not
+	// cross a string boundary
+	iv_t phi_rec;
+	uint64_t rec_shift = 0;
 	// BWT length
 	// uint_t BWT_length;
 	// no runs
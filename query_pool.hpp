@@ -0,0 +1,133 @@
+/*
+ * Multithreaded driver for count and locate queries on the extended r-index.
+ *
+ * The index is loaded once and shared by all the worker threads, since
+ * count and locate queries only read it. The workers pull chunks of
+ * patterns from a shared counter and store the results by pattern index,
+ * so that the output files can be written in input order.
+ */
+
+#ifndef QUERY_POOL_HPP_
+#define QUERY_POOL_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "r_index.hpp"
+
+// result of a single pattern query
+struct query_res{
+	// number of occurrences
+	uint_t nocc = 0;
+	// query time in milliseconds (0 with batch)
+	float time = 0;
+	// occurrences of the pattern (locate only)
+	std::vector<uint_t> occ;
+	// occurrences of the pattern as (string id, offset) pairs (locate only)
+	std::vector<seq_pos_t> socc;
+};
+
+template<class index_t>
+class query_pool{
+
+public:
+	/*
+	 * idx: shared index, threads: number of worker threads,
+	 * chunk: number of patterns taken from the queue at once,
+	 * limit: maximum number of occurrences per pattern (0 = all),
+	 * seq: report the occurrences as (string id, offset) pairs,
+	 * batch: locate each chunk with locate_batch, for throughput only: the
+	 * per-pattern times are not measured
+	 */
+	query_pool(index_t &idx_, int threads_, size_t chunk_ = 64, bool locate_ = false, bool first_ = false, uint_t limit_ = 0, bool seq_ = false, bool batch_ = false):
+		idx(idx_), threads(threads_), chunk(chunk_), locate(locate_), first(first_), limit(limit_), seq(seq_), batch(batch_)
+	{
+		if(threads < 1){ threads = 1; }
+		if(chunk < 1){ chunk = 1; }
+	}
+
+	/*
+	 * answer the queries for all patterns, res[i] is the result of patterns[i]
+	 */
+	void run(std::vector<std::string> &patterns, std::vector<query_res> &res){
+
+		res.clear();
+		res.resize(patterns.size());
+		// reset queue of chunks
+		next_chunk = 0;
+		// no need for more threads than chunks
+		size_t nchunks = (patterns.size() + chunk - 1) / chunk;
+		size_t nth = std::min(size_t(threads), nchunks);
+
+		std::vector<std::thread> workers;
+		workers.reserve(nth);
+		for(size_t t=0; t<nth; ++t){
+			workers.emplace_back(&query_pool::worker, this, std::ref(patterns), std::ref(res));
+		}
+		for(auto &t: workers){ t.join(); }
+	}
+
+private:
+	// worker thread: process chunks of patterns until the queue is empty
+	void worker(std::vector<std::string> &patterns, std::vector<query_res> &res){
+
+		size_t n = patterns.size();
+		while(true){
+			// take the next chunk
+			size_t b = (next_chunk++) * chunk;
+			if(b >= n){ break; }
+			size_t e = std::min(n, b + chunk);
+
+			if(locate and !seq and batch){
+				// the Phi chains of the chunk are advanced in lockstep
+				std::vector<std::string> P(patterns.begin()+b, patterns.begin()+e);
+				idx.locate_batch(P, [&](size_t j, uint_t pos){ res[b+j].occ.push_back(pos); }, first, limit);
+				for(size_t i=b; i<e; ++i){ res[i].nocc = res[i].occ.size(); }
+				continue;
+			}
+			for(size_t i=b; i<e; ++i){
+
+				auto before = std::chrono::high_resolution_clock::now();
+				if(locate and seq){
+					res[i].socc = idx.locate_seq(patterns[i], first, limit);
+					res[i].nocc = res[i].socc.size();
+				}
+				else if(locate){
+					res[i].nocc = idx.locate(patterns[i], [&](uint_t pos){ res[i].occ.push_back(pos); }, first, limit);
+				}
+				else{
+					auto rn = idx.count(patterns[i]);
+					res[i].nocc = rn.second>=rn.first ? (rn.second-rn.first)+1 : 0;
+				}
+				auto after = std::chrono::high_resolution_clock::now();
+
+				std::chrono::duration<double, std::milli> patt_time = after - before;
+				res[i].time = patt_time.count();
+			}
+		}
+	}
+
+	// shared index
+	index_t &idx;
+	// number of worker threads
+	int threads;
+	// number of patterns per chunk
+	size_t chunk;
+	// compute locate queries instead of count queries
+	bool locate;
+	// first rotations sampled
+	bool first;
+	// maximum number of occurrences per pattern
+	uint_t limit;
+	// occurrences as (string id, offset) pairs
+	bool seq;
+	// locate the chunks with locate_batch
+	bool batch;
+	// next chunk to process
+	std::atomic<size_t> next_chunk{0};
+};
+
+#endif
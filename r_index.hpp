@@ -12,23 +12,78 @@
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 
 #include <sdsl/wavelet_trees.hpp>
 #include "rle_ebwt.hpp"
 #include "pred_ebwt.hpp"
+#include "pred_array.hpp"
+#include "sa_samples.hpp"
+#include "ef_vector.hpp"
+#include "heads_vector.hpp"
+#include "dna_heads.hpp"
+#include "rle_blocks.hpp"
+#include "packed_vector.hpp"
+#include "mm_file.hpp"
 
-typedef rle_ebwt rle_t;
-typedef pred_ebwt pred_t;
 typedef std::pair<uint_t,uint_t> range_t;
+// occurrence as (string id, offset in the string)
+typedef std::pair<uint_t,uint_t> seq_pos_t;
+
+// magic number of the memory mapped index file (.erm)
+#define ERM_MAGIC 0x31504d4d49524545ULL
+// number of patterns advanced in lockstep by count_batch
+#define COUNT_BATCH 16
+// number of Phi chains advanced in lockstep by locate_batch
+#define LOCATE_BATCH 32
+// the first occurrence of the patterns of at least this many times the sample rate
+// characters is located with the gCA samples, if any, also when the other
+// occurrences are located with Phi
+#define SA_HYBRID 2
+// magic number of the index files (.eri) with the predecessor structure in plain arrays
+#define ERI_ARRAY_MAGIC 0x3159415252414545ULL
 
-// define r index class
+/*
+ * read the header of the index files (.eri) with the predecessor structure
+ * in plain arrays, return false (reading nothing) if there is none
+ */
+inline bool read_eri_header(std::istream& in){
+
+	uint64_t magic = 0;
+	auto start = in.tellg();
+	in.read((char*)&magic,sizeof(magic));
+	if(in and magic == ERI_ARRAY_MAGIC){ return true; }
+	in.clear();
+	in.seekg(start);
+	return false;
+}
+
+/*
+ * define r index class
+ * rle_t: run-length encoded eBWT type
+ * pred_t: predecessor data structure type
+ * sa_t: sampled gCA type
+ */
+template<class rle_t = rle_ebwt<>, class pred_t = pred_ebwt<>, class sa_t = sa_samples<>>
 class r_index{
 
+	template<class, class, class> friend class r_index;
+
 public:
 	// empty constructor
 	r_index(){}
+	/*
+	 * constructor that copies an index using different data structures,
+	 * used to convert a loaded index to the memory mapped layout
+	 */
+	template<class rle2_t, class pred2_t, class sa2_t>
+	r_index(r_index<rle2_t,pred2_t,sa2_t>& other): bwt(other.bwt), phi(other.phi), B(other.B), K(other.K), ktab(other.ktab), sa(other.sa) {}
 	// constructor
-	r_index(std::string input, uint_t bsize = 1, bool stream = 0, bool pfpebwt = 0, bool verbose = 0, bool first = 0){
+	r_index(std::string input, uint_t bsize = 1, bool stream = 0, bool pfpebwt = 0, bool verbose = 0, bool first = 0, uint_t kmer = 0,
+	        uint_t sa_rate = 0){
 		// get int size
 		int isize = sizeof(uint_t);
 		if( pfpebwt ){ isize = 5; }
@@ -41,14 +96,14 @@ public:
 		B = bsize;
 		if(!stream && !pfpebwt){
 			// run length encoded eBWT
-			bwt = rle_ebwt(heads, lens, B,verbose);
+			bwt = rle_t(heads, lens, B,verbose);
 		}
 		else{
 			// open streams
 			std::ifstream head_s(heads);
 			std::ifstream len_s(lens);
 			// run length encoded eBWT
-			bwt = rle_ebwt(head_s, len_s, heads, B, isize,verbose);
+			bwt = rle_t(head_s, len_s, heads, B, isize,verbose);
 		}
 
 		std::cout << "(2/3) Compute the predecessor search data structure\n";
@@ -59,7 +114,7 @@ public:
 		
 		if(!stream && !pfpebwt){
 			// construct predecessor data structure for the eBWT
-			phi = pred_ebwt(s_samples, e_samples, st_pos, verbose);
+			phi = pred_t(s_samples, e_samples, st_pos, verbose);
 			//phi.construct_rank_select_dt();
 		}
 		else{
@@ -68,19 +123,51 @@ public:
 			std::ifstream e_samples_s(e_samples);
 			std::ifstream st_pos_s(st_pos);
 			// construct predecessor data structure for the eBWT
-			phi = pred_ebwt(s_samples_s, e_samples_s, st_pos_s, bwt.size(), isize, verbose, first);
+			phi = pred_t(s_samples_s, e_samples_s, st_pos_s, bwt.size(), isize, verbose, first);
 			//phi.construct_rank_select_dt();
 		}
 
-        std::cout << "(3/3) Serialize the eBWT r-index data structure\n";
-		std::string path = input.append(".eri");
-		std::ofstream out(path);
+		// gCA samples computed by pfp_ssa (bebwt -g), if any
+		std::vector<uint_t> g_pos, g_val;
+		bool sampled = false;
+		std::ifstream g_samples_s(input + ".gsam");
+		if(sa_rate > 0 and g_samples_s.is_open()){
+			uint64_t v = 0;
+			g_samples_s.read(reinterpret_cast<char*>(&v), isize);
+			if(v != sa_rate){
+				std::cerr << "Error, " << input << ".gsam has sample rate " << v << " instead of " << sa_rate << ". exiting..." << std::endl;
+				exit(1);
+			}
+			g_samples_s.seekg(0, std::ios::end);
+			uint64_t m = (uint64_t(g_samples_s.tellg())/isize - 1)/2;
+			g_samples_s.seekg(isize, std::ios::beg);
+			g_pos.resize(m); g_val.resize(m);
+			for(uint64_t i=0; i<m; ++i){
+				v = 0; g_samples_s.read(reinterpret_cast<char*>(&v), isize); g_pos[i] = v;
+				v = 0; g_samples_s.read(reinterpret_cast<char*>(&v), isize); g_val[i] = v;
+			}
+			sampled = true;
+		}
 
-		uint_t space = serialize(out);
-		if(verbose) std::cout << "TOT space: " << space << " Bytes" << std::endl << std::endl;
+		store(input, verbose, kmer, sa_rate, sampled ? &g_pos : NULL, &g_val);
+	}
+	/*
+	 * constructor from the eBWT runs and the gCA samples computed in memory
+	 * by er-build, the index is stored in input.eri as above. g_pos and g_val
+	 * are the eBWT positions and values of the gCA samples every sa_rate
+	 */
+	r_index(std::string input, rle_builder& runs, std::vector<uint_t>& s_samples, std::vector<uint_t>& e_samples,
+	        std::vector<uint_t>& st_pos, std::vector<uint_t>& g_pos, std::vector<uint_t>& g_val,
+	        bool verbose = 0, bool first = 0, uint_t kmer = 0, uint_t sa_rate = 0){
 
-		out.close();
+		std::cout << "(1/3) Compute the RLE eBWT data structure\n";
+		B = runs.B;
+		bwt = rle_t(runs, verbose);
+
+		std::cout << "(2/3) Compute the predecessor search data structure\n";
+		phi = pred_t(s_samples, e_samples, st_pos, bwt.size(), verbose, first);
 
+		store(input, verbose, kmer, sa_rate, &g_pos, &g_val);
 	}
 
    /*
@@ -89,7 +176,9 @@ public:
 	range_t count(std::string &P){
 
 		range_t range = {0,bwt.size()-1};
-		uint_t m = P.size();
+		uint_t k = 0;
+		// start from the k-mer table, if any
+		uint_t m = kmer_start(P,range,k);
 
 		for(int i=0; i<m and range.second >= range.first; ++i){
 			// get new range
@@ -98,6 +187,62 @@ public:
 
 		return range;
 	}
+	/*
+	 * Return the eBWT ranges of the patterns in P. COUNT_BATCH patterns are
+	 * advanced in lockstep and each LF step is split in three passes over
+	 * them (prefetch the main bitvector, find the blocks and prefetch the
+	 * heads, finish the ranks), so that their cache misses overlap.
+	 */
+	std::vector<range_t> count_batch(std::vector<std::string> &P){
+
+		std::vector<range_t> res(P.size());
+		// number of characters left, current character and blocks of the range ends
+		uint_t left[COUNT_BATCH];
+		char c[COUNT_BATCH];
+		std::pair<uint_t,uint_t> bl[COUNT_BATCH], br[COUNT_BATCH];
+		// active patterns of the batch
+		size_t act[COUNT_BATCH];
+
+		for(size_t b=0; b<P.size(); b+=COUNT_BATCH){
+
+			size_t na = 0;
+			for(size_t j=b; j<std::min(P.size(), b+COUNT_BATCH); ++j){
+				res[j] = {0,bwt.size()-1};
+				uint_t k = 0;
+				left[j-b] = kmer_start(P[j],res[j],k);
+				if(left[j-b] > 0 and res[j].second >= res[j].first){ act[na++] = j; }
+			}
+
+			while(na > 0){
+				// prefetch the main bitvector at the range ends
+				for(size_t a=0; a<na; ++a){
+					range_t &rn = res[act[a]];
+					bwt.prefetch(rn.first);
+					bwt.prefetch(rn.second+1);
+				}
+				// find the blocks of the range ends and prefetch their heads
+				for(size_t a=0; a<na; ++a){
+					size_t j = act[a], t = j-b;
+					range_t &rn = res[j];
+					c[t] = P[j][left[t]-1];
+					bl[t] = bwt.block_of(rn.first,B);
+					br[t] = bwt.block_of(rn.second+1,B);
+					bwt.prefetch_run(bl[t].first,c[t]);
+					bwt.prefetch_run(br[t].first,c[t]);
+				}
+				// finish the LF steps and remove the completed patterns
+				size_t na1 = 0;
+				for(size_t a=0; a<na; ++a){
+					size_t j = act[a], t = j-b;
+					res[j] = LF(res[j],c[t],bl[t],br[t]);
+					if(--left[t] > 0 and res[j].second >= res[j].first){ act[na1++] = j; }
+				}
+				na = na1;
+			}
+		}
+
+		return res;
+	}
 	/*
 	range_t count_(std::string &P){
 
@@ -134,6 +279,24 @@ public:
 
 		return {l,l+c_inside-1};
 	}
+	/*
+	 * LF step of LF(rn,c), where bl and br are the blocks of rn.first and rn.second+1
+	 */
+	range_t LF(range_t rn, char c, std::pair<uint_t,uint_t> &bl, std::pair<uint_t,uint_t> &br){
+
+		//if character does not appear in the text, return empty pair
+		if((c==127 and bwt.C[c]==bwt.size()) || bwt.C[c]>=bwt.C[c+1]){ return {1,0}; }
+		//number of c before the interval
+		uint_t c_before = bwt.rank(rn.first,c,bl);
+		//number of c inside the interval rn
+		uint_t c_inside = bwt.rank(rn.second+1,c,br) - c_before;
+		//if there are no c in the interval, return empty range
+		if(c_inside==0) return {1,0};
+
+		uint_t l = bwt.C[c] + c_before;
+
+		return {l,l+c_inside-1};
+	}
 	/*
 	range_t LF_(range_t rn, char c){
 
@@ -156,6 +319,10 @@ public:
 	 */
 	uint_t Phi(uint_t i){
 
+		// the predecessor is in the same string of i and the result does not wrap around
+		uint_t rank = phi.pred_rank(i), res;
+		if(rank > 0 and phi.phi_step(rank-1, i - phi.select(rank-1), res)){ return res; }
+
 		//jr is the rank of the predecessor of i (circular)
 		//auto pred_query = phi.circular_rank_predecessor_triple(i);
 		auto pred_query = phi.circular_rank_predecessor_tuple(i);
@@ -197,6 +364,9 @@ public:
 		// compute distance between the two indices
 		// assert(i >= j);
 		uint_t delta = i-j;
+		// the result does not wrap around its string
+		uint_t res;
+		if(phi.phi_step(jr, delta, res)){ return res; }
 
 		// sample at the end of previous run
 		uint_t prev_sample = phi.sample_last( phi.f_to_r(jr)-1 );
@@ -208,61 +378,194 @@ public:
 		else{                               return phi.curr_start_pos(prev_sample) + ((prev_sample + delta)%next); }
 	}
 
+	/*
+	 * return Phi(k). If Phi(k) = k + d is in the same sample interval of k
+	 * (periodic regions), the following steps also use the predecessor sample
+	 * of k and add d: t is the number of these further steps (0 otherwise)
+	 */
+	uint_t Phi_stretch(uint_t k, bool first, int64_t &d, uint_t &t){
+		return Phi_stretch(k, phi.pred_rank(k), first, d, t);
+	}
+
+	/*
+	 * Phi_stretch(k, first, d, t), where rank = phi.pred_rank(k)
+	 */
+	uint_t Phi_stretch(uint_t k, uint_t rank, bool first, int64_t &d, uint_t &t){
+
+		t = 0;
+		uint_t s, room;
+		if(rank == 0){ return first ? Phi_first(k) : Phi(k); }
+		uint_t p = phi.select(rank-1);
+		phi.phi_record(rank-1, s, room);
+		if(k - p >= room){ return first ? Phi_first(k) : Phi(k); }
+		uint_t res = s + (k - p);
+		// the stretch goes on while the positions x satisfy x - p < room and
+		// precede the next sample (checked only if res is in the interval)
+		if(res >= p and res - p < room){
+			uint_t hi = std::min(phi.next_sample(rank-1), p + room);
+			d = int64_t(s) - int64_t(p);
+			if(res < hi){ t = 1 + (d > 0 ? (hi - 1 - res) / d : (res - p) / (-d)); }
+		}
+		return res;
+	}
+
 	/*
 	 * return the conjugate array interval of pattern P + the last sample of the interval
 	 */
 	std::pair<range_t, uint_t> count_and_get_occ(std::string &P){
 
-		uint_t k = 0, ks = 0;
-		char c;
 		range_t range = {0,bwt.size()-1};
-		k = phi.sample_last(bwt.nrun()-1);
-		ks = phi.curr_start_pos(k);
-		range_t range1;
-
-		uint_t m = P.size();
+		uint_t k = phi.sample_last(bwt.nrun()-1);
+		// start from the k-mer table, if any
+		uint_t m = kmer_start(P,range,k);
+		uint_t ks = phi.curr_start_pos(k);
 
 		for(uint_t i=0;i<m and range.second>=range.first;++i){
-			// current character
-			c = P[m-i-1];
-			// new range computed with the LF step
-			range1 = LF(range,c);
-			//if suffix can be left-extended with char
-			if(range1.first <= range1.second){
-				// compute the last sample of the new interval 
-				if(bwt[range.second] == c){
-					// last c is at the end of range.
-					if( k > ks ){	k--;	}
-					else
-					{
-						k = phi.next_start_pos(k) - 1;
-					}
-				// else find new sample
-				}else{
-					// find last c in range (there must be one because range1 is not empty)
-					// and get its sample (must be sampled because it is at the end of a run)
-					// note: by previous check, bwt[range.second] != c, so we can use argument range.second
-					uint_t rnk = bwt.rank(range.second,c,B);
-					//this is the rank of the last c
-					rnk--;
-					//jump to the corresponding BWT position
-					uint_t j = bwt.select(rnk,c,B);
-					//run of position j
-					uint_t run_of_j = bwt.run_of_position(j);
-					// get sample
-					k = phi.sample_last(run_of_j);
-					// get new starting pos
-					ks = phi.curr_start_pos(k);
-					if( k != ks ){ k--; }
-					else
-					{
-						k = phi.next_start_pos(k)-1;
-					}
+			// extend the range and its last sample with the current character
+			extend(range,k,ks,P[m-i-1]);
+		}
+		return {range, k};
+	}
+
+	/*
+	 * return the sample rate of the gCA samples (0 if the index does not store them)
+	 */
+	uint_t sa_rate(){
+		return sa.sample_rate();
+	}
+
+	/*
+	 * locate with sa_value instead of Phi the patterns with at most h occurrences
+	 * (0 = never, the default, and -1 = always). It requires the gCA samples, each
+	 * occurrence is then found with less than s LF steps, and the locate queries
+	 * do not access the predecessor structure
+	 */
+	void set_sa_locate(uint_t h){
+		sa_occ = h;
+	}
+
+	/*
+	 * return the conjugate array interval of pattern P + the gCA value at its end,
+	 * the first occurrence located, and set walk if the n_occ occurrences (at most
+	 * limit) are located with sa_value instead of Phi (see set_sa_locate). The value
+	 * at the end of the range is found with sa_value after a plain count when walk
+	 * may be set, since n_occ is then needed first, and when P has at least
+	 * SA_HYBRID*s characters, as it is cheaper than tracking the samples during the
+	 * backward search. Otherwise it is found with count_and_get_occ
+	 */
+	std::pair<range_t, uint_t> locate_start(std::string &P, uint_t limit, bool &walk){
+
+		walk = false;
+		uint_t s = sa.sample_rate();
+		if(s == 0 or (sa_occ == 0 and P.size() < SA_HYBRID*s)){ return count_and_get_occ(P); }
+		range_t range = count(P);
+		if(range.second < range.first){ return {range, 0}; }
+		uint_t n_occ = (range.second-range.first)+1;
+		if(limit > 0 and limit < n_occ){ n_occ = limit; }
+		walk = (n_occ <= sa_occ);
+		return {range, sa_value(range.second)};
+	}
+
+	/*
+	 * return the eBWT position of the rotation preceding the one at position i
+	 */
+	uint_t LF(uint_t i){
+
+		char c = bwt[i];
+		return bwt.C[c] + bwt.rank(i,c,B);
+	}
+
+	/*
+	 * return the gCA value at eBWT position i with LF steps to the nearest
+	 * sampled position, each step moves to the previous offset in the string
+	 */
+	uint_t sa_value(uint_t i){
+
+		uint_t v, steps = 0;
+		while(!sa.lookup(i,v)){ i = LF(i); ++steps; }
+		return v + steps;
+	}
+
+	/*
+	 * one step of count_and_get_occ: extend the range and its last sample k with
+	 * character c, ks is the starting position of the sequence containing k
+	 */
+	void extend(range_t &range, uint_t &k, uint_t &ks, char c){
+
+		// new range computed with the LF step
+		range_t range1 = LF(range,c);
+		//if suffix can be left-extended with char
+		if(range1.first <= range1.second){
+			// compute the last sample of the new interval 
+			if(bwt[range.second] == c){
+				// last c is at the end of range.
+				if( k > ks ){	k--;	}
+				else
+				{
+					k = phi.next_start_pos(k) - 1;
+				}
+			// else find new sample
+			}else{
+				// find last c in range (there must be one because range1 is not empty)
+				// and get its sample (must be sampled because it is at the end of a run)
+				// note: by previous check, bwt[range.second] != c, so we can use argument range.second
+				uint_t rnk = bwt.rank(range.second,c,B);
+				//this is the rank of the last c
+				rnk--;
+				//jump to the corresponding BWT position
+				uint_t j = bwt.select(rnk,c,B);
+				//run of position j
+				uint_t run_of_j = bwt.run_of_position(j);
+				// get sample
+				k = phi.sample_last(run_of_j);
+				// get new starting pos
+				ks = phi.curr_start_pos(k);
+				if( k != ks ){ k--; }
+				else
+				{
+					k = phi.next_start_pos(k)-1;
 				}
 			}
-			range = range1;
 		}
-		return {range, k};
+		range = range1;
+	}
+
+	/*
+	 * compute the table with the range and the last sample of every DNA
+	 * string of length kmer, used to skip the first kmer steps of the searches
+	 */
+	void build_kmer_table(uint_t kmer){
+
+		K = kmer;
+		if(K == 0){ ktab = mm_array<uint_t>(); return; }
+		// three entries per k-mer: range and last sample, empty range by default
+		std::vector<uint_t> tab(3*(1ULL << (2*K)), 0);
+		for(size_t i=0; i<tab.size(); i+=3){ tab[i] = 1; }
+		range_t range = {0,bwt.size()-1};
+		uint_t k = phi.sample_last(bwt.nrun()-1);
+		fill_kmer_table(tab, 0, 0, range, k);
+		ktab = mm_array<uint_t>(std::move(tab));
+	}
+
+	/*
+	 * set range and k to the range and the last sample of the last K characters
+	 * of P using the k-mer table, and return the number of characters left.
+	 * If the table cannot be used, range and k are unchanged and P.size() is returned.
+	 */
+	uint_t kmer_start(std::string &P, range_t &range, uint_t &k){
+
+		uint_t m = P.size();
+		if(K == 0 or m < K) return m;
+		// code of the last K characters, the last one is the least significant
+		uint64_t code = 0;
+		for(uint_t i=0; i<K; ++i){
+			int x = dna_code(P[m-i-1]);
+			if(x < 0) return m;
+			code |= uint64_t(x) << (2*i);
+		}
+		range = {ktab[3*code], ktab[3*code+1]};
+		k = ktab[3*code+2];
+		return m-K;
 	}
 	/*
 	std::pair<range_t, uint_t> count_and_get_occ_(std::string &P){
@@ -328,14 +631,146 @@ public:
 	}
 	*/
 	/*
-	 * locate all occurrences of P and return them in an array
-	 * (space consuming if result is big).
+	 * iterator over the occurrences of a pattern, each call of next()
+	 * computes one Phi step (or one sa_value, see set_sa_locate), so
+	 * that the occurrences are never stored
 	 */
-	std::vector<uint_t> locate_all(std::string& P, bool first = 0){
+	class locate_iterator{
+
+	public:
+		/*
+		 * occurrences of P, at most limit occurrences if limit > 0
+		 */
+		locate_iterator(r_index &idx_, std::string &P, bool first_ = 0, uint_t limit = 0): idx(&idx_), first(first_){
+
+			std::pair<range_t, uint_t> res = idx->locate_start(P, limit, walk);
+
+			uint_t L = std::get<0>(res).first;
+			R = std::get<0>(res).second;
+			k = std::get<1>(res);
+
+			n_occ = R>=L ? (R-L)+1 : 0;
+			if(limit > 0 and limit < n_occ){ n_occ = limit; }
+		}
+
+		// number of occurrences returned by the iterator
+		uint_t size() const { return n_occ; }
+
+		bool has_next() const { return i < n_occ; }
+
+		/*
+		 * return the next occurrence, the first one is the last sample of the range
+		 */
+		uint_t next(){
+			// compute predecessor gCA value
+			if(i > 0){
+				if(walk){ k = idx->sa_value(R-i); }
+				else if(t > 0){ k += d; --t; }
+				else{ k = idx->Phi_stretch(k, first, d, t); }
+			}
+			++i;
+			return k;
+		}
+
+	private:
+		// index
+		r_index *idx;
+		// first rotations sampled
+		bool first;
+		// number of occurrences, occurrences returned, current occurrence, end of the range
+		uint_t n_occ = 0, i = 0, k = 0, R = 0;
+		// the occurrences are located with sa_value
+		bool walk = false;
+		// remaining steps of the current stretch, each one adds d
+		uint_t t = 0;
+		int64_t d = 0;
+	};
+
+	/*
+	 * return an iterator over the occurrences of P (at most limit if limit > 0)
+	 */
+	locate_iterator locate_iter(std::string& P, bool first = 0, uint_t limit = 0){
+		return locate_iterator(*this, P, first, limit);
+	}
+
+	/*
+	 * call report(occ) for each occurrence of P (at most limit if limit > 0)
+	 * without storing them, return the number of reported occurrences
+	 */
+	template<class F>
+	uint_t locate(std::string& P, F report, bool first = 0, uint_t limit = 0){
+
+		locate_iterator it(*this, P, first, limit);
+		while(it.has_next()){ report(it.next()); }
+
+		return it.size();
+	}
+
+	/*
+	 * call report(j, occ) for each occurrence of P[j] (at most limit per pattern
+	 * if limit > 0). The Phi chains of LOCATE_BATCH patterns are advanced in
+	 * lockstep and each Phi step is split in three passes over them (prefetch the
+	 * predecessor structure, find the predecessors and prefetch their samples and
+	 * records, finish the steps), so that their cache misses overlap. The chains
+	 * of the completed patterns are replaced by the next ones, and the occurrences
+	 * of each pattern are reported in the order of locate. The patterns located
+	 * with sa_value (see set_sa_locate) are reported when their chain would start.
+	 */
+	template<class F>
+	void locate_batch(std::vector<std::string> &P, F report, bool first = 0, uint_t limit = 0){
+
+		// Phi chain of a pattern: occurrences left, current occurrence and rank of its
+		// predecessor, remaining steps of the current stretch (each one adds d)
+		struct phi_chain{ size_t j; uint_t left, k, rank, t; int64_t d; };
+		phi_chain ch[LOCATE_BATCH];
+		size_t na = 0, next = 0;
+
+		while(na > 0 or next < P.size()){
+			// start the chains of the next patterns, the first occurrence is the toehold
+			while(na < LOCATE_BATCH and next < P.size()){
+				bool walk;
+				std::pair<range_t, uint_t> res = locate_start(P[next], limit, walk);
+				uint_t L = res.first.first, R = res.first.second;
+				uint_t n_occ = R>=L ? (R-L)+1 : 0;
+				if(limit > 0 and limit < n_occ){ n_occ = limit; }
+				if(n_occ > 0){ report(next, res.second); }
+				if(walk){ for(uint_t i=1; i<n_occ; ++i){ report(next, sa_value(R-i)); } }
+				else if(n_occ > 1){ ch[na++] = {next, n_occ-1, res.second, 0, 0, 0}; }
+				next++;
+			}
+			// prefetch the predecessor structure at the current occurrences
+			for(size_t a=0; a<na; ++a){
+				if(ch[a].t == 0){ phi.prefetch(ch[a].k); }
+			}
+			// find the predecessors and prefetch their samples and records
+			for(size_t a=0; a<na; ++a){
+				if(ch[a].t > 0) continue;
+				ch[a].rank = phi.pred_rank(ch[a].k);
+				if(ch[a].rank > 0){ phi.prefetch_sample(ch[a].rank-1); }
+			}
+			// finish the Phi steps and remove the completed chains
+			size_t na1 = 0;
+			for(size_t a=0; a<na; ++a){
+				phi_chain &c = ch[a];
+				if(c.t > 0){ c.k += c.d; --c.t; }
+				else{ c.k = Phi_stretch(c.k, c.rank, first, c.d, c.t); }
+				report(c.j, c.k);
+				if(--c.left > 0){ ch[na1++] = c; }
+			}
+			na = na1;
+		}
+	}
+
+	/*
+	 * locate all occurrences of P (at most limit if limit > 0) and return
+	 * them in an array (space consuming if result is big, see locate).
+	 */
+	std::vector<uint_t> locate_all(std::string& P, bool first = 0, uint_t limit = 0){
 
 		std::vector<uint_t> OCC;
 
-		std::pair<range_t, uint_t> res = count_and_get_occ(P);
+		bool walk;
+		std::pair<range_t, uint_t> res = locate_start(P, limit, walk);
 
 		uint_t L = std::get<0>(res).first;
 		uint_t R = std::get<0>(res).second;
@@ -344,15 +779,23 @@ public:
 		//std::cout << L << " : " << R << " - " << k << "\n";
 
 		uint_t n_occ = R>=L ? (R-L)+1 : 0;
+		if(limit > 0 and limit < n_occ){ n_occ = limit; }
 		OCC.reserve(n_occ);
-		if(n_occ>0){
+		if(walk){
+			// each occurrence is found with LF steps to the nearest gCA sample
+			for(uint_t i=0; i<n_occ; ++i){ OCC.push_back(i == 0 ? k : sa_value(R-i)); }
+		}
+		else if(n_occ>0){
 			// push last sample as first occurrence 
 			OCC.push_back(k);
-			// for each other occurrence apply Phi step
+			// for each other occurrence apply Phi step, the steps
+			// with the same predecessor sample add the same d
+			uint_t t = 0;
+			int64_t d = 0;
 			for(uint_t i=1; i<n_occ; ++i){
 				// compute predecessor gCA value
-				if(first){ k = Phi_first(k); }
-				else{ k = Phi(k); }
+				if(t > 0){ k += d; --t; }
+				else{ k = Phi_stretch(k, first, d, t); }
 				// add occurrence
 				OCC.push_back(k);
 			}
@@ -391,6 +834,43 @@ public:
 		return OCC;
 	}
 	*/
+	/*
+	 * convert the positions in OCC into (string id, offset) pairs. Consecutive positions
+	 * in the same string share the rank and select queries, and if OCC is sorted
+	 * a rank query is needed only when a string with no occurrences is skipped.
+	 */
+	std::vector<seq_pos_t> seq_offsets(std::vector<uint_t>& OCC){
+
+		std::vector<seq_pos_t> SOCC;
+		SOCC.reserve(OCC.size());
+		// current string and its interval [st,en)
+		uint_t id = 0, st = 1, en = 0;
+		for(auto pos: OCC){
+			if(pos < st or pos >= en){
+				// try the next string before searching with a rank query
+				if(en > st and pos >= en and pos < phi.string_start(id+2)){ id++; }
+				else{ id = phi.string_id(pos); }
+				st = phi.string_start(id);
+				en = phi.string_start(id+1);
+			}
+			SOCC.push_back({id, pos-st});
+		}
+
+		return SOCC;
+	}
+
+	/*
+	 * locate the occurrences of P (at most limit if limit > 0) and return them
+	 * as (string id, offset) pairs sorted by string and offset
+	 */
+	std::vector<seq_pos_t> locate_seq(std::string& P, bool first = 0, uint_t limit = 0){
+
+		std::vector<uint_t> OCC = locate_all(P, first, limit);
+		std::sort(OCC.begin(), OCC.end());
+
+		return seq_offsets(OCC);
+	}
+
 	/* serialize the structure to the ostream
 	 * \param out	 the ostream
 	 */
@@ -398,6 +878,11 @@ public:
 
 		uint_t w_bytes = 0;
 
+		if(array_pred()){
+			uint64_t magic = ERI_ARRAY_MAGIC;
+			out.write((char*)&magic,sizeof(magic));
+			w_bytes += sizeof(magic);
+		}
 		out.write((char*)&B,sizeof(B));
 
 		w_bytes += sizeof(B);
@@ -405,6 +890,18 @@ public:
 		w_bytes += bwt.serialize(out);
 		w_bytes += phi.serialize(out);
 
+		// optional k-mer table
+		out.write((char*)&K,sizeof(K));
+		w_bytes += sizeof(K);
+		if(K > 0){
+			out.write((char*)ktab.data(),ktab.size()*sizeof(uint_t));
+			w_bytes += ktab.size()*sizeof(uint_t);
+		}
+		// Phi records
+		w_bytes += phi.serialize_records(out);
+		// optional gCA samples
+		w_bytes += sa.serialize(out);
+
 		return w_bytes;
 	}
 
@@ -413,11 +910,93 @@ public:
 	 */
 	void load(std::istream& in) {
 
+		if(read_eri_header(in) != array_pred()){
+			std::cerr << "Error, the index was stored with a different predecessor structure. exiting..." << std::endl;
+			exit(1);
+		}
 		in.read((char*)&B,sizeof(B));
 
 		bwt.load(in);
 		phi.load(in);
 
+		// k-mer table (missing in older indexes)
+		K = 0;
+		if(in.peek() != EOF){ in.read((char*)&K,sizeof(K)); }
+		if(K > 0){
+			std::vector<uint_t> tab(3*(1ULL << (2*K)));
+			in.read((char*)tab.data(),tab.size()*sizeof(uint_t));
+			ktab = mm_array<uint_t>(std::move(tab));
+		}
+		// Phi records (missing in older indexes)
+		if(in.peek() != EOF){ phi.load_records(in); }
+		else{ phi.build_records(); }
+		// gCA samples (missing in older indexes)
+		if(in.peek() != EOF){ sa.load(in); }
+	}
+
+	/* store the index in the memory mapped layout (.erm)
+	 * \param out	 the ostream
+	 */
+	uint64_t serialize_mm(std::ostream& out){
+
+		mm_writer w(out);
+
+		w.value(uint64_t(ERM_MAGIC));
+		w.value(uint64_t(sizeof(uint_t)));
+		w.value(uint64_t(rle_t::mm_kind()));
+		w.value(uint64_t(B));
+
+		bwt.write_mm(w);
+		phi.write_mm(w);
+
+		w.value(uint64_t(K));
+		ktab.write(w);
+		phi.write_records_mm(w);
+		sa.write_mm(w);
+
+		return w.bytes();
+	}
+
+	/* map the index from a memory mapped layout file (.erm), the
+	 * data structures are queried in place
+	 * \param filename	 the .erm file
+	 */
+	void map(const std::string& filename) {
+
+		mapping = std::make_shared<mm_file>(filename);
+		mm_reader r(*mapping);
+
+		if(r.value<uint64_t>() != ERM_MAGIC){
+			std::cerr << "Error, " << filename << " is not a memory mapped extended r-index. exiting..." << std::endl;
+			exit(1);
+		}
+		if(r.value<uint64_t>() != sizeof(uint_t)){
+			std::cerr << "Error, " << filename << " was built with a different integer width (check er-index/er-index64). exiting..." << std::endl;
+			exit(1);
+		}
+		if(r.value<uint64_t>() != rle_t::mm_kind()){
+			std::cerr << "Error, " << filename << " was stored with a different layout. exiting..." << std::endl;
+			exit(1);
+		}
+		B = r.value<uint64_t>();
+
+		bwt.map(r);
+		phi.map(r);
+
+		K = r.value<uint64_t>();
+		ktab.map(r);
+		// Phi records (missing in older layouts)
+		if(!r.at_end()){ phi.map_records(r); }
+		else{ phi.build_records(); }
+		// gCA samples (missing in older layouts)
+		if(!r.at_end()){ sa.map(r); }
+	}
+
+	/*
+	 * return the number of distinct characters of the eBWT
+	 */
+	uint_t sigma(){
+		return bwt.sigma();
 	}
 
 	uint_t getBWTlen(){
@@ -425,13 +1004,313 @@ public:
 	}
 
 private:
+	// true if the samples of the predecessor structure are stored in plain arrays
+	static constexpr bool array_pred(){ return std::is_same<pred_t, pred_ebwt<pred_array>>::value; }
+
+	// build the k-mer table and the gCA samples, if any, and serialize the index to input.eri.
+	// The gCA samples are taken from g_pos and g_val if given, otherwise computed with LF steps
+	void store(std::string input, bool verbose, uint_t kmer, uint_t sa_rate,
+	           std::vector<uint_t> *g_pos = NULL, std::vector<uint_t> *g_val = NULL){
+
+		if(kmer > 0 or (sa_rate > 0 and g_pos == NULL)){
+			// the rank and select supports are otherwise built when the index is loaded
+			bwt.construct_rank_select_dt();
+			phi.construct_rank_select_dt();
+		}
+		if(kmer > 0){
+			std::cout << "Compute the " << kmer << "-mer table\n";
+			build_kmer_table(kmer);
+		}
+		if(sa_rate > 0 and g_pos != NULL){
+			sa = sa_t(*g_pos, *g_val, bwt.size(), sa_rate);
+		}
+		else if(sa_rate > 0){
+			std::cout << "Compute the gCA samples every " << sa_rate << " positions\n";
+			build_sa_samples(sa_rate);
+		}
+
+        std::cout << "(3/3) Serialize the eBWT r-index data structure\n";
+		std::string path = input.append(".eri");
+		std::ofstream out(path);
+
+		uint_t space = serialize(out);
+		if(verbose) std::cout << "TOT space: " << space << " Bytes" << std::endl << std::endl;
+
+		out.close();
+	}
+
+	/*
+	 * sample the gCA values at the offsets multiple of rate in each string, if they were
+	 * not computed by pfp_ssa (er-index -c on files built without bebwt -g). Each string is traversed
+	 * backwards with LF steps from the eBWT position of its last sample in text order, the
+	 * first position of the run of the sample
+	 */
+	void build_sa_samples(uint_t rate){
+
+		uint_t nstr = phi.string_id(bwt.size()-1)+1;
+		std::vector<std::pair<uint_t,uint_t>> smp;
+		smp.reserve(bwt.size()/rate + nstr);
+		for(uint_t id=0; id<nstr; ++id){
+			uint_t st = phi.string_start(id), en = phi.string_start(id+1);
+			// last sample of the string, every string contains a sample
+			uint_t jr = phi.pred_rank(en-1)-1;
+			uint_t v = phi.select(jr), i = bwt.run_start(phi.f_to_r(jr));
+			for(uint_t s=0; s<en-st; ++s){
+				if((v-st) % rate == 0){ smp.push_back({i,v}); }
+				i = LF(i);
+				v = (v == st) ? en-1 : v-1;
+			}
+		}
+		std::sort(smp.begin(), smp.end());
+		std::vector<uint_t> pos(smp.size()), val(smp.size());
+		for(size_t j=0; j<smp.size(); ++j){ pos[j] = smp[j].first; val[j] = smp[j].second; }
+		std::vector<std::pair<uint_t,uint_t>>().swap(smp);
+		sa = sa_t(pos, val, bwt.size(), rate);
+	}
+
+	// code of a DNA character in the k-mer table, -1 for the other characters
+	static inline int dna_code(char c){
+		switch(c){
+			case 'A': return 0;
+			case 'C': return 1;
+			case 'G': return 2;
+			case 'T': return 3;
+			default:  return -1;
+		}
+	}
+
+	// fill the entries of the k-mer table of the strings ending with the d characters of code
+	void fill_kmer_table(std::vector<uint_t> &tab, uint_t d, uint64_t code, range_t range, uint_t k){
+
+		if(d == K){
+			tab[3*code] = range.first; tab[3*code+1] = range.second; tab[3*code+2] = k;
+			return;
+		}
+		for(int x=0; x<4; ++x){
+			range_t range1 = range;
+			uint_t k1 = k, ks1 = phi.curr_start_pos(k);
+			extend(range1,k1,ks1,"ACGT"[x]);
+			// the entries of the empty ranges are already set
+			if(range1.second >= range1.first){ fill_kmer_table(tab, d+1, code | (uint64_t(x) << (2*d)), range1, k1); }
+		}
+	}
+
 	// run-length encoded eBWT
 	rle_t bwt;
 	// predecessor data structure eBWT
 	pred_t phi;
 	// block size
 	uint_t B;
+	// length of the k-mers in the k-mer table (0 if there is no table)
+	uint_t K = 0;
+	// k-mer table: range and last sample of each k-mer
+	mm_array<uint_t> ktab;
+	// sampled gCA values (none if the sample rate is 0)
+	sa_t sa;
+	// patterns with at most this many occurrences are located with sa_value
+	uint_t sa_occ = 0;
+	// mapped file of the memory mapped layout
+	std::shared_ptr<mm_file> mapping;
 };
 
+// extended r-index with the block size Bc known at compile time (0 = runtime block size)
+template<uint_t Bc = 0>
+using r_index_t = r_index<rle_ebwt<sd_vector,sdsl::wt_huff<>,Bc>, pred_ebwt<>>;
+
+// extended r-index with the samples of the predecessor structure in plain arrays
+template<uint_t Bc = 0>
+using r_index_arr_t = r_index<rle_ebwt<sd_vector,sdsl::wt_huff<>,Bc>, pred_ebwt<pred_array>>;
+
+// extended r-index queried in place from the memory mapped layout
+template<uint_t Bc = 0>
+using r_index_mm_t = r_index<rle_ebwt<ef_vector,heads_vector,Bc>, pred_ebwt<ef_vector,packed_vector>, sa_samples<ef_vector,packed_vector>>;
+typedef r_index_mm_t<> r_index_mm;
+
+// extended r-index queried in place with the heads packed in 4 bits (e.g. DNA)
+template<uint_t Bc = 0>
+using r_index_mm_dna_t = r_index<rle_ebwt<ef_vector,dna_heads,Bc>, pred_ebwt<ef_vector,packed_vector>, sa_samples<ef_vector,packed_vector>>;
+typedef r_index_mm_dna_t<> r_index_mm_dna;
+
+// extended r-index queried in place with the interleaved run-block layout of the eBWT
+typedef r_index<rle_blocks, pred_ebwt<ef_vector,packed_vector>, sa_samples<ef_vector,packed_vector>> r_index_mm_blocks;
+
+/*
+ * return true if the index file (.eri) stores the predecessor structure in plain arrays
+ */
+inline bool eri_array_layout(const std::string& filename){
+
+	std::ifstream in(filename);
+	if(!in){ std::cerr << "Error opening " << filename << ". exiting..." << std::endl; exit(1); }
+	return read_eri_header(in);
+}
+
+/*
+ * rewrite the index filename.eri with the samples of the predecessor structure
+ * in plain arrays (pred_array), that make Phi faster using more space
+ */
+inline void store_array_index(const std::string& filename, bool verbose){
+
+	std::cout << "Store the predecessor structure of the eBWT r-index in plain arrays\n";
+	std::ifstream in(filename + ".eri");
+	r_index<> idx = r_index<>();
+	idx.load(in);
+	in.close();
+
+	r_index_arr_t<> idx_arr(idx);
+	std::ofstream out(filename + ".eri");
+	uint_t space = idx_arr.serialize(out);
+	if(verbose) std::cout << "TOT space: " << space << " Bytes" << std::endl;
+	out.close();
+}
+
+// store the memory mapped layout of the loaded index idx in filename.erm
+template<class index_t>
+inline void store_mapped_layout(index_t& idx, const std::string& filename, bool blocks, bool verbose){
+
+	std::ofstream out(filename + ".erm");
+	uint64_t space = 0;
+	if(blocks){
+		r_index_mm_blocks idx_mm(idx);
+		space = idx_mm.serialize_mm(out);
+	}
+	// pack the heads in 4 bits if the alphabet is small enough (e.g. DNA)
+	else if(idx.sigma() <= DNA_HEADS_SIGMA){
+		r_index_mm_dna idx_mm(idx);
+		space = idx_mm.serialize_mm(out);
+	}
+	else{
+		r_index_mm idx_mm(idx);
+		space = idx_mm.serialize_mm(out);
+	}
+	if(verbose) std::cout << "Memory mapped index space: " << space << " Bytes" << std::endl;
+	out.close();
+}
+
+/*
+ * store the memory mapped layout (filename.erm) of the index filename.eri,
+ * blocks selects the interleaved run-block layout of the eBWT. The mapped
+ * layout always stores the samples of the predecessor structure in ef_vector
+ */
+inline void store_mapped_index(const std::string& filename, bool blocks, bool verbose){
+
+	std::cout << "Store the memory mapped layout of the eBWT r-index\n";
+	bool arr = eri_array_layout(filename + ".eri");
+	std::ifstream in(filename + ".eri");
+	if(arr){
+		r_index_arr_t<> idx = r_index_arr_t<>();
+		idx.load(in);
+		store_mapped_layout(idx, filename, blocks, verbose);
+	}
+	else{
+		r_index<> idx = r_index<>();
+		idx.load(in);
+		store_mapped_layout(idx, filename, blocks, verbose);
+	}
+}
+
+/*
+ * return the layout (mm_kind) of a memory mapped layout file (.erm)
+ */
+inline uint64_t erm_layout(const std::string& filename){
+
+	std::ifstream in(filename);
+	uint64_t header[3] = {0,0,0};
+	in.read((char*)header,sizeof(header));
+	if(!in or header[0] != ERM_MAGIC){
+		std::cerr << "Error, " << filename << " is not a memory mapped extended r-index. exiting..." << std::endl;
+		exit(1);
+	}
+	return header[2];
+}
+
+/*
+ * return the block size of an index file (.eri, or .erm if mapped)
+ */
+inline uint_t index_block_size(const std::string& filename, bool mapped){
+
+	std::ifstream in(filename);
+	if(!in){ std::cerr << "Error opening " << filename << ". exiting..." << std::endl; exit(1); }
+	if(mapped){
+		uint64_t header[4] = {0,0,0,0};
+		in.read((char*)header,sizeof(header));
+		return header[3];
+	}
+	uint_t B = 0;
+	read_eri_header(in);
+	in.read((char*)&B,sizeof(B));
+	return B;
+}
+
+/*
+ * load the index of filename with type index_t and call f(idx, load),
+ * where load is the loading time in milliseconds
+ */
+template<class index_t, class F>
+void with_loaded_index(const std::string& filename, F&& f){
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	std::ifstream in(filename + ".eri");
+	index_t idx = index_t();
+	idx.load(in);
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+	uint64_t load = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+	f(idx, load);
+}
+
+/*
+ * map the memory mapped layout of filename with type index_t and call
+ * f(idx, load), the data structures are queried in place
+ */
+template<class index_t, class F>
+void with_mapped_index(const std::string& filename, F&& f){
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	index_t idx = index_t();
+	idx.map(filename + ".erm");
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+	uint64_t load = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+	f(idx, load);
+}
+
+// load (or map) the index compiled for block size Bc (0 = any block size)
+template<uint_t Bc, class F>
+void with_index_bs(const std::string& filename, bool mapped, F&& f){
+
+	if(!mapped){
+		if(eri_array_layout(filename + ".eri")){ with_loaded_index<r_index_arr_t<Bc>>(filename, f); }
+		else{ with_loaded_index<r_index_t<Bc>>(filename, f); }
+	}
+	else if(erm_layout(filename + ".erm") == dna_heads::mm_kind){ with_mapped_index<r_index_mm_dna_t<Bc>>(filename, f); }
+	else{ with_mapped_index<r_index_mm_t<Bc>>(filename, f); }
+}
+
+/*
+ * load (or map) the index of filename with the type matching its layout and
+ * block size and call f(idx, load), f must accept any index type
+ * (e.g. a generic lambda)
+ */
+template<class F>
+void with_index(const std::string& filename, bool mapped, F&& f){
+
+	if(mapped && erm_layout(filename + ".erm") == rle_blocks::mm_kind()){
+		// the run-block layout does not depend on the block size
+		with_mapped_index<r_index_mm_blocks>(filename, f);
+		return;
+	}
+	// dispatch the common block sizes to the versions compiled for them
+	switch(index_block_size(filename + (mapped ? ".erm" : ".eri"), mapped)){
+		case 1: with_index_bs<1>(filename, mapped, f); break;
+		case 2: with_index_bs<2>(filename, mapped, f); break;
+		case 4: with_index_bs<4>(filename, mapped, f); break;
+		case 8: with_index_bs<8>(filename, mapped, f); break;
+		default: with_index_bs<0>(filename, mapped, f);
+	}
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+/*
+ * Run-length encoded eBWT with an interleaved block layout, that can be
+ * stored in a mapped file.
+ *
+ * It is an alternative to rle_ebwt for the memory mapped index. The runs are
+ * grouped in blocks of RUN_BLOCK runs, and for each block we store together
+ * its starting position, the number of occurrences of each character before
+ * it, and the lengths and the heads of its runs (one or two cache lines).
+ * The block containing a position is found with a table sampling one
+ * position every 2^shift, so that a rank query reads the table entry and
+ * one block (plus the following block start).
+ */
+
+#ifndef RLE_BLOCKS_HPP_
+#define RLE_BLOCKS_HPP_
+
+#include <vector>
+
+#include "sd_vector.hpp"
+#include "mm_file.hpp"
+
+// number of runs per block
+#define RUN_BLOCK 8
+
+class rle_blocks{
+
+public:
+	// BWT C vector (F column)
+	std::vector<uint_t> C;
+	// identifier of the layout in the memory mapped index
+	static constexpr uint64_t mm_kind(){ return 2; }
+	// empty constructor
+	rle_blocks(){}
+	/*
+	 * constructor from a rle eBWT (e.g. rle_ebwt), used to convert
+	 * a loaded index to the memory mapped layout
+	 */
+	template<class rle_t>
+	rle_blocks(rle_t& other){
+		n = other.size();
+		R = other.nrun();
+		C = other.C;
+		std::vector<uint8_t> heads(R);
+		std::vector<uint_t> lens(R);
+		for(uint64_t i=0; i<R; ++i){
+			heads[i] = other.bwt_heads[i];
+			lens[i] = other.run_at(i);
+		}
+		build(heads, lens);
+	}
+
+	/*
+	* return eBWT size
+	*/
+	uint_t size(){
+		return n;
+	}
+
+	/*
+	* return eBWT number of runs
+	*/
+	uint_t nrun(){
+		return R;
+	}
+
+	/*
+	* return the number of distinct characters of the eBWT
+	*/
+	uint_t sigma(){
+		return nchar;
+	}
+
+	/*
+	* return a eBWT position
+	*/
+	char operator[](uint_t i){
+		uint64_t b = find_block(i);
+		const uint_t *blk = block(b);
+		uint64_t pos = blk[0];
+		for(uint64_t t=0; t<RUN_BLOCK; ++t){
+			pos += len_of(blk)[t];
+			if(pos > i) return head_of(blk)[t];
+		}
+		assert(false);
+		return 0;
+	}
+
+	/*
+	 * return in which run the index i is contained
+	 */
+	uint_t run_of_position(uint_t i){
+		uint64_t b = find_block(i);
+		const uint_t *blk = block(b);
+		uint64_t pos = blk[0];
+		for(uint64_t t=0; t<RUN_BLOCK; ++t){
+			pos += len_of(blk)[t];
+			if(pos > i) return b*RUN_BLOCK + t;
+		}
+		assert(false);
+		return 0;
+	}
+
+	/*
+	 * <first run of the block containing position i, first position of the block>
+	 */
+	std::pair<uint_t,uint_t> block_of(uint_t i, uint_t B){
+		uint64_t b = find_block(i);
+		return {b*RUN_BLOCK, block(b)[0]};
+	}
+
+	/*
+	 * number of c before position i
+	 */
+	uint_t rank(uint_t i, char c, uint_t B){
+		return rank(i, c, block_of(i,B));
+	}
+
+	/*
+	 * number of c before position i, where blk = block_of(i,B)
+	 */
+	uint_t rank(uint_t i, char c, std::pair<uint_t,uint_t> blk){
+		int32_t s = slot[uint8_t(c)];
+		if(s < 0) return 0;
+		const uint_t *b = block(blk.first/RUN_BLOCK);
+		const uint_t *len = len_of(b);
+		const uint8_t *h = head_of(b);
+		uint64_t pos = b[0], r = b[1+s];
+		for(uint64_t t=0; t<RUN_BLOCK; ++t){
+			if(pos + len[t] > i) return r + (h[t]==uint8_t(c))*(i-pos);
+			r += (h[t]==uint8_t(c))*len[t];
+			pos += len[t];
+		}
+		return r;
+	}
+
+	/*
+	 * prefetch the sampled block of position i
+	 */
+	void prefetch(uint_t i){
+		__builtin_prefetch(bucket.data() + (uint64_t(i) >> shift));
+	}
+
+	/*
+	 * prefetch the block of run r
+	 */
+	void prefetch_run(uint_t r, char c){
+		const uint_t *b = block(r/RUN_BLOCK);
+		__builtin_prefetch(b);
+		__builtin_prefetch(b + stride);
+	}
+
+	/*
+	 * position of i-th character c. i starts from 0!
+	 */
+	uint_t select(uint_t i, char c, uint_t B){
+		int32_t s = slot[uint8_t(c)];
+		assert(s >= 0);
+		// the block is between two samples
+		uint64_t q = i / sel_step[s];
+		uint64_t lo = sel[sel_off[s] + q], hi = sel[sel_off[s] + q + 1];
+		// last block with at most i c before it
+		while(lo < hi){
+			uint64_t mid = (lo + hi + 1) / 2;
+			if(block(mid)[1+s] <= i){ lo = mid; } else { hi = mid-1; }
+		}
+		// scan the block
+		const uint_t *b = block(lo);
+		const uint_t *len = len_of(b);
+		const uint8_t *h = head_of(b);
+		uint64_t pos = b[0], r = b[1+s];
+		for(uint64_t t=0; t<RUN_BLOCK; ++t){
+			if(h[t]==uint8_t(c)){
+				if(r + len[t] > i) return pos + (i-r);
+				r += len[t];
+			}
+			pos += len[t];
+		}
+		assert(false);
+		return 0;
+	}
+
+	/* store the structure in a mapped file
+	 * \param w	 the mapped file writer
+	 */
+	void write_mm(mm_writer& w) {
+
+		w.value(n); w.value(R); w.value(nchar);
+		w.value(nblocks); w.value(stride); w.value(shift);
+		w.array(C.data(),128);
+		slot.write(w);
+		blocks.write(w);
+		bucket.write(w);
+		sel_step.write(w);
+		sel_off.write(w);
+		sel.write(w);
+	}
+
+	/* map the structure from a mapped file
+	 * \param r	 the mapped file reader
+	 */
+	void map(mm_reader& r) {
+
+		n = r.value<uint64_t>(); R = r.value<uint64_t>(); nchar = r.value<uint64_t>();
+		nblocks = r.value<uint64_t>(); stride = r.value<uint64_t>(); shift = r.value<uint64_t>();
+		const uint_t *C_ = r.array<uint_t>(128);
+		C = std::vector<uint_t>(C_, C_+128);
+		slot.map(r);
+		blocks.map(r);
+		bucket.map(r);
+		sel_step.map(r);
+		sel_off.map(r);
+		sel.map(r);
+	}
+
+private:
+	// build the blocks, the sampled positions and the select samples
+	void build(std::vector<uint8_t> &heads, std::vector<uint_t> &lens){
+		// assign a slot to each character
+		std::vector<int32_t> slot_v(256,-1);
+		nchar = 0;
+		for(auto c: heads){ if(slot_v[c] < 0){ slot_v[c] = nchar++; } }
+		// block: start, counts, run lengths, run heads
+		nblocks = (R + RUN_BLOCK - 1) / RUN_BLOCK;
+		stride = 1 + nchar + RUN_BLOCK + (RUN_BLOCK + sizeof(uint_t) - 1) / sizeof(uint_t);
+		// the last block is a sentinel starting at n with the total counts
+		std::vector<uint_t> blocks_v((nblocks+1)*stride, 0);
+		std::vector<uint64_t> cnt(nchar, 0);
+		uint64_t pos = 0;
+		for(uint64_t b=0; b<=nblocks; ++b){
+			uint_t *blk = blocks_v.data() + b*stride;
+			blk[0] = pos;
+			for(uint64_t s=0; s<nchar; ++s){ blk[1+s] = cnt[s]; }
+			if(b == nblocks) break;
+			uint8_t *h = (uint8_t*)(blk + 1 + nchar + RUN_BLOCK);
+			for(uint64_t t=0; t<RUN_BLOCK and b*RUN_BLOCK+t<R; ++t){
+				uint64_t j = b*RUN_BLOCK+t;
+				blk[1+nchar+t] = lens[j];
+				h[t] = heads[j];
+				cnt[slot_v[heads[j]]] += lens[j];
+				pos += lens[j];
+			}
+		}
+		assert(pos == n);
+		// one sampled position every 2^shift, about one per block
+		shift = 0;
+		while(nblocks > 0 and (n >> (shift+1)) >= nblocks){ shift++; }
+		std::vector<uint64_t> bucket_v((n >> shift) + 1);
+		uint64_t b = 0;
+		for(uint64_t k=0; k<bucket_v.size(); ++k){
+			// last block starting before k*2^shift
+			while(b < nblocks and blocks_v[(b+1)*stride] <= (k << shift)){ b++; }
+			bucket_v[k] = b;
+		}
+		// for each character the last block with at most q*step occurrences before it
+		std::vector<uint64_t> step_v(nchar), off_v(nchar+1, 0), sel_v;
+		for(uint64_t s=0; s<nchar; ++s){
+			step_v[s] = cnt[s] / (nblocks/4 + 1) + 1;
+			off_v[s] = sel_v.size();
+			uint64_t last = nblocks > 0 ? nblocks-1 : 0;
+			b = 0;
+			for(uint64_t q=0; q <= cnt[s]/step_v[s] + 1; ++q){
+				while(b < last and blocks_v[(b+1)*stride+1+s] <= q*step_v[s]){ b++; }
+				sel_v.push_back(b);
+			}
+		}
+		off_v[nchar] = sel_v.size();
+		slot     = mm_array<int32_t>(std::move(slot_v));
+		blocks   = mm_array<uint_t>(std::move(blocks_v));
+		bucket   = mm_array<uint64_t>(std::move(bucket_v));
+		sel_step = mm_array<uint64_t>(std::move(step_v));
+		sel_off  = mm_array<uint64_t>(std::move(off_v));
+		sel      = mm_array<uint64_t>(std::move(sel_v));
+	}
+
+	/*
+	 * return the block containing position i (the sentinel if i == n), it is
+	 * between the blocks of the sampled positions before and after i, that can
+	 * be far apart where the runs are short
+	 */
+	inline uint64_t find_block(uint64_t i) const {
+		uint64_t k = i >> shift;
+		uint64_t lo = bucket[k], hi = k+1 < bucket.size() ? bucket[k+1] : nblocks;
+		// last block starting at most at i
+		while(lo < hi){
+			uint64_t mid = (lo + hi + 1) / 2;
+			if(blocks[mid*stride] <= i){ lo = mid; } else { hi = mid-1; }
+		}
+		return lo;
+	}
+
+	inline const uint_t* block(uint64_t b) const { return blocks.data() + b*stride; }
+
+	inline const uint_t* len_of(const uint_t *blk) const { return blk + 1 + nchar; }
+
+	inline const uint8_t* head_of(const uint_t *blk) const { return (const uint8_t*)(blk + 1 + nchar + RUN_BLOCK); }
+
+	// eBWT length, number of runs and of distinct characters
+	uint64_t n = 0, R = 0, nchar = 0;
+	// number of blocks, words per block, log2 of the sampling of the positions
+	uint64_t nblocks = 0, stride = 0, shift = 0;
+	// slot of each character in the counts of the blocks (-1 if the character is not in the eBWT)
+	mm_array<int32_t> slot;
+	// blocks of runs
+	mm_array<uint_t> blocks;
+	// block containing each sampled position
+	mm_array<uint64_t> bucket;
+	// select samples of each character: step, offset in sel, blocks
+	mm_array<uint64_t> sel_step, sel_off, sel;
+};
+
+#endif
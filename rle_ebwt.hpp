@@ -10,18 +10,105 @@
 
 #include <sdsl/wavelet_trees.hpp>
 #include "sd_vector.hpp"
+#include "mm_file.hpp"
 
+// prefetch the heads for a rank query on run r, if supported by the heads type
+template<class wt_t>
+inline auto prefetch_heads(wt_t &wt, uint_t r, char c, int) -> decltype(wt.prefetch(r,c), void()){
+	wt.prefetch(r,c);
+}
+template<class wt_t>
+inline void prefetch_heads(wt_t &, uint_t, char, long){}
+
+/*
+ * rle eBWT received one run at a time, that is then turned into a rle_ebwt
+ * (e.g. the runs computed in memory by er-build)
+ */
+class rle_builder{
+
+public:
+	// B: block size, keep_heads: store the heads for the wavelet tree
+	rle_builder(uint_t B_, bool keep_heads_ = true): B(B_), keep_heads(keep_heads_), C(128,0), onset_letter(128){}
+
+	/*
+	 * append a run of len characters c
+	 */
+	void push(uint8_t c, uint64_t len){
+		// if the run contains at least two characters
+		if(len > 1){
+			// increase C vector entry
+			C[c] += len-1;
+			// insert len-1 0s
+			BWTlength += len-1;
+		}
+		// create onset vector for letter bitvector
+		onset_letter[c].push_back(C[c]);
+		//push back a bit set only at the end of a block
+		if(R%B==B-1){ onset_main.push_back(BWTlength); }
+		// increase BWT length
+		BWTlength++;
+		// increase char counter
+		C[c]++;
+		R++;
+		if(keep_heads){ heads.push_back(c); }
+	}
+
+	// block size
+	uint_t B;
+	// store the heads
+	bool keep_heads;
+	// number of runs and eBWT length
+	uint64_t R = 0, BWTlength = 0;
+	// number of occurrences of each character
+	std::vector<uint_t> C;
+	// onset vectors of the main bitvector and of the letter bitvectors
+	std::vector<uint_t> onset_main;
+	std::vector< std::vector<uint_t> > onset_letter;
+	// heads of the runs
+	std::string heads;
+};
+
+/*
+ * bv_t: compressed bitvector type (sd_vector, or ef_vector for the memory mapped index)
+ * wt_t: type of the eBWT heads (sdsl::wt_huff<>, or heads_vector for the memory mapped index)
+ * Bc: block size known at compile time, so that the run scans can be unrolled (0 = runtime B)
+ */
+template<class bv_t = sd_vector, class wt_t = sdsl::wt_huff<>, uint_t Bc = 0>
 class rle_ebwt{
 
+	template<class, class, uint_t> friend class rle_ebwt;
+
 public:
+	// type of the heads
+	typedef wt_t heads_type;
+	// identifier of the layout in the memory mapped index (the one of the heads)
+	static constexpr uint64_t mm_kind(){ return wt_t::mm_kind; }
 	// wavelet tree
-	sdsl::wt_huff<> bwt_heads;
+	wt_t bwt_heads;
 	// BWT C vector (F column)
 	std::vector<uint_t> C;
 	// present characters
 	//cstd::vector<bool> C_p;
 	// empty constructor
 	rle_ebwt(){}
+	/*
+	 * Constructor that copies a rle eBWT using different data structures,
+	 * used to convert a loaded index to the memory mapped layout
+	 */
+	template<class bv2_t, class wt2_t, uint_t Bc2>
+	rle_ebwt(rle_ebwt<bv2_t,wt2_t,Bc2>& other){
+		BWTlength = other.BWTlength;
+		R = other.R;
+		B = other.B;
+		check_block_size();
+		C = other.C;
+		main_bv = bv_t(other.main_bv);
+		letter_bv = std::vector<bv_t>(128);
+		for(int i=0; i<128; ++i){
+			if( other.letter_bv[i].size() > 0 ){ letter_bv[i] = bv_t(other.letter_bv[i]); }
+		}
+		bwt_heads = wt_t(other.bwt_heads);
+	}
 	/*
 	* Constructor that takes in input the files with the rle eBWT and the block size
 	* and construct the data structure for rank and select queries on the rle eBWT
@@ -34,6 +121,7 @@ public:
 
 		assert(heads.size() == lens.size());
 		B = B_;
+		check_block_size();
 
 		// initialize bitvector data structures
 		letter_bv.resize(128);
@@ -105,76 +193,24 @@ public:
 	rle_ebwt(std::ifstream& headfile, std::ifstream& lenfile, std::string &headstr, uint_t B_, int isize, bool verbose = false){
 		// set block size
 		B = B_;
+		check_block_size();
+		// the wavelet tree is built from headstr
+		rle_builder runs(B, false);
 		// get no runs
 		headfile.seekg(0, std::ios::end);
-		R = headfile.tellg();
-    	headfile.seekg(0, std::ios::beg);
-		// initialize bitvector data structures
-		letter_bv.resize(128);
-		// initialize main onset vector
-		std::vector<uint_t> onset_main;
-		onset_main.reserve(R/B);
-		// initialize letters onset vector
-		std::vector< std::vector<uint_t> > onset_letter;
-		onset_letter.resize(128);
-		// initialize C vector and R
-		C.resize(128);
-		// iterate over heads
-		uint64_t currLen = 0, BWTlen = 0;
+		uint64_t nruns = headfile.tellg();
+		headfile.seekg(0, std::ios::beg);
+		runs.onset_main.reserve(nruns/B);
+		uint64_t currLen = 0;
 		char currHead = 0;
 		// iterate over head vector
-		for(size_t i=0;i<R;++i){
+		for(size_t i=0;i<nruns;++i){
 			// get current run length
 			lenfile.read(reinterpret_cast<char*>(&currLen), isize);
 			headfile >> currHead;
-			// if the run contains at least two characters
-			if(currLen > 1){
-				// increase C vector entry
-				C[currHead] += currLen-1;
-				// insert lens[i]-1 0s
-				BWTlength += currLen-1;
-				BWTlen += currLen-1;
-			}
-			// create onset vector for letter bitvector
-			onset_letter[currHead].push_back(C[currHead]);
-			//push back a bit set only at the end of a block
-			if(i%B==B-1){ onset_main.push_back(BWTlength); }
-			// increase BWT length
-			BWTlength++;
-			BWTlen++;
-			// increase char counter
-			C[currHead]++;
-		}
-		// print stats
-		if(verbose)
-		{
-			std::cout << "eBWT length: " << BWTlen;
-			std::cout << "\nNumber of eBWT equal-letter sampled runs: " << R << std::endl;
-		}
-	    // check BWT length
-	    #if M64 == 0
-	    	// std::cout << "entra";
-	        // if we are in 32 bit mode, check that parse has less than 2^32-2 words
-	        if(BWTlen > pow(2,32) - 1){ 
-	            // the input file is too big
-	            std::cerr << "Error, the eBWT length is > 4.29 GB, please use ./er-index64. exiting..." << std::endl;
-	            exit(-1);
-	        }
-	    #endif 
-		// construct the main compressed bitvector
-		main_bv = sd_vector(onset_main, BWTlength);
-		// construct the compressed bitvector for each character
-		for(int i=0; i<128; ++i){
-			// if we have at least one character
-			if(C[i] > 0){
-				// construct compressed bit vector
-				letter_bv[i] = sd_vector(onset_letter[i], C[i]);
-			}
+			runs.push(currHead, currLen);
 		}
-		// construct C vector
-		memmove(&C[1], &C[0], 127*sizeof(uint_t));
-		C[0] = 0;
-		for(int i=1; i<128; ++i){ C[i] += C[i-1]; }
+		build(runs, verbose);
 		// close streams
 		headfile.close();
 		lenfile.close();
@@ -182,6 +218,19 @@ public:
 		sdsl::construct(bwt_heads, headstr.c_str(), 1);
 	}
 
+	/*
+	 * constructor from the runs pushed to a rle_builder
+	 */
+	rle_ebwt(rle_builder& runs, bool verbose = false){
+		// set block size
+		B = runs.B;
+		check_block_size();
+		build(runs, verbose);
+		// construct the wavalet tree for the eBWT heads
+		sdsl::construct_im(bwt_heads, runs.heads.c_str(), 1);
+		std::string().swap(runs.heads);
+	}
+
 	/*
 	* return eBWT size
 	*/
@@ -189,6 +238,15 @@ public:
 		return BWTlength;
 	}
 
+	/*
+	* return the number of distinct characters of the eBWT
+	*/
+	uint_t sigma(){
+		uint_t s = 0;
+		for(int i=0; i<128; ++i){ s += (letter_bv[i].size() > 0); }
+		return s;
+	}
+
 	/*
 	* return eBWT number of runs
 	*/
@@ -209,7 +267,7 @@ public:
 	uint_t run_of_position(uint_t i){
 
 		uint_t last_block = main_bv.rank1(i);
-		uint_t current_run = last_block*B;
+		uint_t current_run = last_block*block_size();
 
 		//current position in the string: the first of a block
 		uint_t pos = 0;
@@ -218,7 +276,7 @@ public:
 		assert(pos <= i);
 
 		//otherwise, scan at most B runs
-		while(pos < i)
+		for(uint_t t=0; t<block_size() and pos<i; ++t)
 		{
 			pos += run_at(current_run);
 			current_run++;
@@ -240,14 +298,14 @@ public:
 
 		// compute current run position
 		uint_t last_block = main_bv.rank1(i);
-		uint_t current_run = last_block*B;
+		uint_t current_run = last_block*block_size();
 
 		//current position in the string: the first of a block
 		uint_t pos = 0;
 		if(last_block>0){ pos = main_bv.select1(last_block-1)+1; }
 
-		// while the position is smaller than i
-		while(pos < i){
+		// while the position is smaller than i (at most B runs)
+		for(uint_t t=0; t<block_size() and pos<i; ++t){
 			// add run length
  			pos += run_at(current_run);
 			current_run++;
@@ -263,6 +321,19 @@ public:
 
 	}
 
+	/*
+	 * position of the first character of the i-th run
+	 */
+	uint_t run_start(uint_t i){
+		// first position of the block containing the run
+		uint_t b = i / block_size();
+		uint_t pos = 0;
+		if(b>0){ pos = main_bv.select1(b-1)+1; }
+		// add the lengths of the previous runs of the block
+		for(uint_t r=b*block_size(); r<i; ++r){ pos += run_at(r); }
+		return pos;
+	}
+
 	/*
 	 * length of i-th run
 	 */
@@ -297,17 +368,33 @@ public:
 		// if(letter_bv[c].size()==0) return 0;
 		// if i is equal the size of the eBWT
 		if(i==BWTlength) return letter_bv[c].size();
+		return rank(i, c, block_of(i, B));
+	}
+
+	/*
+	 * <first run of the block containing position i, first position of the block>
+	 */
+	std::pair<uint_t,uint_t> block_of(uint_t i, uint_t B){
 		// get current run
 		uint_t last_block = main_bv.rank1(i);
-		uint_t current_run = last_block*B;
 		// get first position of the previous block
 		uint_t pos = 0;
 		if( last_block>0 ){ pos = main_bv.select1(last_block-1)+1; }
+		return {last_block*(Bc > 0 ? Bc : B), pos};
+	}
+
+	/*
+	 * number of c before position i, where blk = block_of(i,B)
+	 */
+	uint_t rank(uint_t i, char c, std::pair<uint_t,uint_t> blk){
+		if(i==BWTlength) return letter_bv[c].size();
+		uint_t current_run = blk.first;
+		uint_t pos = blk.second;
 		// get distance between i and previous block
 		// assert(pos <= i);
 		uint_t dist = i-pos;
 		//otherwise, scan at most B runs
-		while(pos < i){
+		for(uint_t t=0; t<block_size() and pos<i; ++t){
 			// get current run length
 			//pos += run_length(current_run);
 			pos += run_at(current_run);
@@ -365,10 +452,25 @@ public:
 		return letter_bv[c].select1(rk-1)+1+tail;
 	}*/
 
+	/*
+	 * prefetch the main bitvector for block_of(i,B)
+	 */
+	void prefetch(uint_t i){
+		main_bv.prefetch(i);
+	}
+
+	/*
+	 * prefetch the heads for rank(i,c,blk), where blk.first = r
+	 */
+	void prefetch_run(uint_t r, char c){
+		prefetch_heads(bwt_heads, r, c, 0);
+	}
+
 	/*
 	 * position of i-th character c. i starts from 0!
 	 */
-	uint_t select(uint_t i, char c, uint_t B){
+	uint_t select(uint_t i, char c, uint_t B_){
+		const uint_t B = (Bc > 0 ? Bc : B_);
 		// number of 1s before i
 		uint_t j = letter_bv[c].rank1(i);
 		//starting position of i-th c inside its run
@@ -450,25 +552,118 @@ public:
 		in.read((char*)&nChar,sizeof(nChar));
 		std::vector<int> selChar; selChar.resize(nChar);
 		in.read((char*)selChar.data(),selChar.size()*sizeof(int));
-		letter_bv = std::vector<sd_vector>(128);
+		letter_bv = std::vector<bv_t>(128);
 		for(int j=0; j<selChar.size(); ++j)
 			{ letter_bv[selChar[j]].load(in); /*C_p[selChar[j]] = 1;*/ }
 		// load BWT heads
 		bwt_heads.load(in);
+		check_block_size();
+
+	}
+
+	/* store the structure in a mapped file
+	 * \param w	 the mapped file writer
+	 */
+	void write_mm(mm_writer& w) {
+
+		w.value(uint64_t(BWTlength));
+		w.value(uint64_t(R));
+		w.value(uint64_t(B));
+		w.array(C.data(),128);
+
+		main_bv.write_mm(w);
+
+		std::vector<int32_t> selChar;
+		for(int i=0; i<128; ++i){ if( letter_bv[i].size() > 0 ){ selChar.push_back(i); } }
+		w.value(uint64_t(selChar.size()));
+		w.array(selChar.data(),selChar.size());
+		for(auto c: selChar){ letter_bv[c].write_mm(w); }
+
+		bwt_heads.write_mm(w);
+	}
+
+	/* map the structure from a mapped file
+	 * \param r	 the mapped file reader
+	 */
+	void map(mm_reader& r) {
+
+		BWTlength = r.value<uint64_t>();
+		R = r.value<uint64_t>();
+		B = r.value<uint64_t>();
+		const uint_t *C_ = r.array<uint_t>(128);
+		C = std::vector<uint_t>(C_, C_+128);
+
+		main_bv.map(r);
 
+		uint64_t nChar = r.value<uint64_t>();
+		const int32_t *selChar = r.array<int32_t>(nChar);
+		letter_bv = std::vector<bv_t>(128);
+		for(uint64_t j=0; j<nChar; ++j){ letter_bv[selChar[j]].map(r); }
+
+		bwt_heads.map(r);
+		check_block_size();
 	}
 
 private:
+	// block size
+	inline uint_t block_size() const { return Bc > 0 ? Bc : B; }
+
+	// construct the bitvectors and the C vector from the runs
+	void build(rle_builder& runs, bool verbose){
+		R = runs.R;
+		BWTlength = runs.BWTlength;
+		// print stats
+		if(verbose)
+		{
+			std::cout << "eBWT length: " << runs.BWTlength;
+			std::cout << "\nNumber of eBWT equal-letter sampled runs: " << R << std::endl;
+		}
+	    // check BWT length
+	    #if M64 == 0
+	        // if we are in 32 bit mode, check that parse has less than 2^32-2 words
+	        if(runs.BWTlength > pow(2,32) - 1){ 
+	            // the input file is too big
+	            std::cerr << "Error, the eBWT length is > 4.29 GB, please use ./er-index64. exiting..." << std::endl;
+	            exit(-1);
+	        }
+	    #endif 
+		// initialize bitvector data structures
+		letter_bv.resize(128);
+		C = runs.C;
+		// construct the main compressed bitvector
+		main_bv = sd_vector(runs.onset_main, BWTlength);
+		// construct the compressed bitvector for each character
+		for(int i=0; i<128; ++i){
+			// if we have at least one character
+			if(C[i] > 0){
+				// construct compressed bit vector
+				letter_bv[i] = sd_vector(runs.onset_letter[i], C[i]);
+			}
+		}
+		// construct C vector
+		memmove(&C[1], &C[0], 127*sizeof(uint_t));
+		C[0] = 0;
+		for(int i=1; i<128; ++i){ C[i] += C[i-1]; }
+	}
+
+	// exit if the block size differs from the one known at compile time
+	void check_block_size(){
+		if(Bc > 0 and B != Bc){
+			std::cerr << "Error, the block size of the index (" << B << ") differs from the compiled one (" << Bc << "). exiting..." << std::endl;
+			exit(1);
+		}
+	}
+
 	// heads and lengths vectors
 	std::vector<char> heads;
 	std::vector<uint_t> lens;
 	uint_t BWTlength = 0;
 	// main bitvector for all characters with support
 	// for rank and select queries
-	sd_vector main_bv;
+	bv_t main_bv;
 	// vector containing one bitvector for each char
 	// with support for rank and select queries
-	std::vector< sd_vector > letter_bv;
+	std::vector< bv_t > letter_bv;
 	// number of runs
 	uint_t R;
 	// block size
@@ -0,0 +1,132 @@
+/*
+ * Sampled gCA values for the locate queries of the extended r-index.
+ *
+ * The eBWT positions whose gCA value is at an offset multiple of the sample
+ * rate s in its string are marked in a compressed bitvector, and their values
+ * are stored in eBWT order. The value at any position is found with at most
+ * s-1 LF steps, since the LF steps move to the previous offset of the same
+ * string and the offset 0 is always sampled.
+ *
+ * bv_t: compressed bitvector type (sd_vector, or ef_vector for the memory mapped index)
+ * iv_t: integer vector type (sdsl::int_vector<>, or packed_vector for the memory mapped index)
+ */
+
+#ifndef SA_SAMPLES_HPP_
+#define SA_SAMPLES_HPP_
+
+#include <vector>
+#include <sdsl/int_vector.hpp>
+
+#include "sd_vector.hpp"
+#include "pred_ebwt.hpp"
+#include "mm_file.hpp"
+
+template<class bv_t = sd_vector, class iv_t = sdsl::int_vector<>>
+class sa_samples{
+
+	template<class, class> friend class sa_samples;
+
+public:
+	// empty constructor (no samples)
+	sa_samples(){}
+	/*
+	 *  constructor that copies the samples using different data structures,
+	 *  used to convert a loaded index to the memory mapped layout
+	 */
+	template<class bv2_t, class iv2_t>
+	sa_samples(sa_samples<bv2_t,iv2_t>& other): rate(other.rate){
+		if(rate == 0) return;
+		marked = bv_t(other.marked);
+		values = iv_t(other.values);
+	}
+	/*
+	 *  constructor from the sampled eBWT positions (sorted), their gCA values,
+	 *  the eBWT length and the sample rate
+	 */
+	sa_samples(std::vector<uint_t>& pos, std::vector<uint_t>& val, uint_t n, uint_t rate_): rate(rate_){
+		sdsl::int_vector<> v(val.size(), 0, bitsize(uint64_t(n)));
+		for(size_t i=0; i<val.size(); ++i){ v[i] = val[i]; }
+		std::vector<uint_t>().swap(val);
+		values = iv_t(v);
+		marked = sd_vector(pos, n);
+		marked.construct_rank_ds();
+		marked.construct_select_ds();
+	}
+
+	/*
+	 *  return the sample rate (0 if there are no samples)
+	 */
+	uint_t sample_rate(){
+		return rate;
+	}
+
+	/*
+	 *  return true and the gCA value of position i in v if it is sampled
+	 */
+	inline bool lookup(uint_t i, uint_t &v){
+		if(!marked.at(i)) return false;
+		v = values[marked.rank1(i)];
+		return true;
+	}
+
+	/*  serialize the structure to the ostream
+	 *  \param out	 the ostream
+	 */
+	uint_t serialize(std::ostream& out){
+
+		out.write((char*)&rate,sizeof(rate));
+		uint_t w_bytes = sizeof(rate);
+		if(rate == 0) return w_bytes;
+
+		w_bytes += marked.serialize(out);
+		w_bytes += values.serialize(out);
+
+		return w_bytes;
+	}
+
+	/* load the structure from the istream
+	 * \param in the istream
+	 */
+	void load(std::istream& in) {
+
+		in.read((char*)&rate,sizeof(rate));
+		if(rate == 0) return;
+
+		marked.load(in);
+		values.load(in);
+	}
+
+	/* store the structure in a mapped file
+	 * \param w	 the mapped file writer
+	 */
+	void write_mm(mm_writer& w) {
+
+		w.value(uint64_t(rate));
+		if(rate == 0) return;
+
+		marked.write_mm(w);
+		values.write_mm(w);
+	}
+
+	/* map the structure from a mapped file
+	 * \param r	 the mapped file reader
+	 */
+	void map(mm_reader& r) {
+
+		rate = r.value<uint64_t>();
+		if(rate == 0) return;
+
+		marked.map(r);
+		values.map(r);
+	}
+
+private:
+	// sample rate, 0 if there are no samples
+	uint64_t rate = 0;
+	// sampled eBWT positions
+	bv_t marked;
+	// gCA values of the sampled positions, in eBWT order
+	iv_t values;
+};
+
+#endif
@@ -23,6 +23,9 @@
     typedef uint32_t uint_t;
 #endif
 
+// also defined in pfpebwt/common.hpp, er-build includes both
+#ifndef READ_FILE_VECTOR_
+#define READ_FILE_VECTOR_
 template<typename T>
 void read_file(const char *filename, std::vector<T>& ptr){
     struct stat filestat;
@@ -46,6 +49,7 @@ void read_file(const char *filename, std::vector<T>& ptr){
 
     fclose(fd);
 }
+#endif
 
 class sd_vector{
 
@@ -139,6 +143,24 @@ public:
 		return bv[i];
 	}
 
+	/*
+	 * prefetch the words of the bitvector read by rank1(i),
+	 * estimated assuming that the set bits are evenly spread
+	 */
+	void prefetch(uint_t i){
+		if(u == 0) return;
+		uint64_t k = (double)i / u * bv.low.size();
+		__builtin_prefetch(bv.high.data() + ((uint64_t(i) >> bv.wl) + k) / 64);
+		__builtin_prefetch(bv.low.data() + (k * bv.wl) / 64);
+	}
+
+	/*
+	 * prefetch the lower bits read by select1(i)
+	 */
+	void prefetch_select(uint_t i){
+		__builtin_prefetch(bv.low.data() + (uint64_t(i) * bv.wl) / 64);
+	}
+
 	uint_t gapAt(uint_t i){
 		if(i==0){ return select1(0)+1; }
 		return select1(i)-select1(i-1);
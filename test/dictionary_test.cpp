@@ -0,0 +1,86 @@
+/*
+ * Check that the parallel construction of the SA and LCP of the dictionary
+ * gives the same saD and lcpD as gsacak, on dictionaries whose phrases share
+ * long prefixes or are periodic, so that the parallel sort exceeds its work
+ * budget and finishes the ranges by prefix doubling.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include <sdsl/bit_vectors.hpp>
+#include <sdsl/int_vector.hpp>
+
+extern "C" {
+#include "pfpebwt/utils.h"
+#include "pfpebwt/xerrors.h"
+}
+#include "pfpebwt/common.hpp"
+#include "pfpebwt/dictionary.hpp"
+
+// concatenation of the phrases, each followed by EndOfWord, and EndOfDict
+std::vector<uint8_t> concat(std::vector<std::string> &phrases){
+  std::vector<uint8_t> d;
+  for(auto &p: phrases){
+    d.insert(d.end(), p.begin(), p.end());
+    d.push_back(EndOfWord);
+  }
+  d.push_back(EndOfDict);
+  return d;
+}
+
+// compare the SA and the LCP computed with th threads with the ones of gsacak
+bool check(std::string name, std::vector<std::string> phrases, int th, bool compact){
+  std::vector<uint8_t> d = concat(phrases), dc = d;
+  std::vector<uint_t> sa(d.size());
+  std::vector<int_t> lcp(d.size());
+  gsacak(&d[0], &sa[0], &lcp[0], nullptr, d.size());
+
+  std::vector<uint32_t> occ(phrases.size(), 1), fchar;
+  dictionary dict(dc, occ, fchar, 10, th, compact);
+  bool ok = (dict.saD == sa);
+  for(size_t i=0; ok and i<d.size(); ++i){
+    if(compact){ ok = dict.lcpC[i] == std::min<int_t>(lcp[i], LCP_CAP); }
+    else{ ok = dict.lcpD[i] == lcp[i]; }
+  }
+  std::cout << name << " (" << th << " threads" << (compact ? ", compact" : "") << "): "
+            << (ok ? "OK" : "FAILED") << std::endl;
+  return ok;
+}
+
+int main(){
+  std::mt19937 gen(42);
+  auto random_string = [&](size_t l){
+    std::string s;
+    for(size_t i=0; i<l; ++i){ s.push_back("ACGT"[gen() % 4]); }
+    return s;
+  };
+
+  // phrases sharing a long prefix, with short distinct tails
+  std::vector<std::string> shared;
+  std::string prefix = random_string(3000);
+  for(size_t i=0; i<400; ++i){ shared.push_back(prefix + random_string(1 + i % 20)); }
+  // periodic phrases, whose suffixes share long prefixes with the suffixes of the same phrase
+  std::vector<std::string> periodic;
+  for(size_t i=1; i<=300; ++i){
+    std::string unit = i % 3 == 0 ? "ACG" : (i % 3 == 1 ? "AC" : "ACGTTG");
+    std::string p;
+    while(p.size() < 10*i){ p += unit; }
+    periodic.push_back(p + random_string(i % 4));
+  }
+  // a few random phrases mixed with the shared ones
+  std::vector<std::string> mixed = shared;
+  for(size_t i=0; i<400; ++i){ mixed.push_back(random_string(20 + i % 50)); }
+
+  bool ok = true;
+  for(int th: {1, 4}){
+    for(bool compact: {false, true}){
+      ok &= check("shared prefixes", shared, th, compact);
+      ok &= check("periodic phrases", periodic, th, compact);
+      ok &= check("mixed phrases", mixed, th, compact);
+    }
+  }
+  return ok ? 0 : 1;
+}